@@ -0,0 +1,268 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "const.h"
+#include "audio_io.h"
+#include "options.h"
+#include "buffers.h"
+
+/*
+ * Benchmark harness for the DTMF pipeline.
+ *
+ * Synthetic audio is generated with dtmf_generate from a deterministic (seeded) list of
+ * events of a given density, optionally mixed with deterministic white noise at a given
+ * level, and the main stages of the pipeline are then timed separately on it:
+ *
+ *   generate       dtmf_generate, events to audio
+ *   read_header    audio_read_header, once per call
+ *   read_samples   audio_read_samples, a buffer of SAMPLE_BUF_SIZE samples at a time
+ *   write_samples  audio_write_samples, a buffer at a time, to /dev/null
+ *   detect         dtmf_detect, audio to events
+ *
+ * Each stage is run several times and the fastest run is reported, as one JSON object
+ * per line on standard output, so that results can be collected and compared over time.
+ */
+
+#define BENCH_USAGE \
+"USAGE: %s [-t SECONDS] [-d DENSITY] [-l LEVEL] [-b BLOCKSIZE] [-r REPEAT] [-S SEED]\n" \
+"   -t SECONDS    length of the synthetic audio (default 600)\n" \
+"   -d DENSITY    DTMF digits per second (range [0, 10], default 2)\n" \
+"   -l LEVEL      mix in white noise at LEVEL dB relative to the tones (default no noise)\n" \
+"   -b BLOCKSIZE  block size used for detection (default 100)\n" \
+"   -r REPEAT     number of runs of each stage, of which the fastest is reported (default 5)\n" \
+"   -S SEED       seed for the events and the noise (default 1)\n"
+
+#define HEADER_CALLS 100000
+
+static uint32_t seed = 1;
+
+//temporary files made so far, all removed on the way out however the benchmark ends
+static char events_path[] = "/tmp/dtmf_bench_events_XXXXXX";
+static char audio_path[] = "/tmp/dtmf_bench_audio_XXXXXX";
+static char noise_path[] = "/tmp/dtmf_bench_noise_XXXXXX";
+static char *temp_paths[3];
+static int num_temp_paths;
+
+static void remove_temp_files(void) {
+    for(int i = 0; i < num_temp_paths; i++) {
+        unlink(temp_paths[i]);
+    }
+}
+
+//helper function to make a temporary file from a template, reporting any error
+static int make_temp_file(char *path) {
+    int fd = mkstemp(path);
+    if(fd < 0) {
+        perror(path);
+        return EOF;
+    }
+    close(fd);
+    temp_paths[num_temp_paths++] = path;
+    return 0;
+}
+
+//helper function to open a file, reporting any error
+static FILE *open_file(const char *path, const char *mode) {
+    FILE *fp = fopen(path, mode);
+    if(fp == NULL)
+        perror(path);
+    return fp;
+}
+
+//helper function to get the next pseudo-random number (a fixed LCG, so runs are repeatable)
+static uint32_t next_random(void) {
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//helper function to write the events: one digit in each slot of 8000/density samples,
+//lasting half the slot and starting at a random point in its first quarter
+static void write_events(FILE *out, int samples, int density) {
+    const char *symbols = "0123456789ABCD*#";
+    if(density == 0)
+        return;
+    int slot = AUDIO_FRAME_RATE / density;
+    for(int s = 0; s + slot <= samples; s += slot) {
+        int start = s + next_random() % (slot / 4);
+        fprintf(out, "%d\t%d\t%c\n", start, start + slot / 2, symbols[next_random() % 16]);
+    }
+}
+
+//helper function to write a noise file of the given number of samples
+static int write_noise(const char *path, int samples) {
+    FILE *out = fopen(path, "w");
+    if(out == NULL)
+        return EOF;
+    AUDIO_HEADER header = {AUDIO_MAGIC, AUDIO_DATA_OFFSET, samples * AUDIO_BYTES_PER_SAMPLE,
+        PCM16_ENCODING, AUDIO_FRAME_RATE, AUDIO_CHANNELS};
+    int ret = audio_write_header(out, &header);
+    static int16_t noise[SAMPLE_BUF_SIZE];
+    for(int i = 0; i < samples && ret == 0; i += SAMPLE_BUF_SIZE) {
+        int n = samples - i < SAMPLE_BUF_SIZE ? samples - i : SAMPLE_BUF_SIZE;
+        for(int j = 0; j < n; j++) {
+            noise[j] = (int16_t) (next_random() & 0xffff);
+        }
+        ret = audio_write_samples(out, noise, n);
+    }
+    if(fclose(out) != 0)
+        ret = EOF;
+    return ret;
+}
+
+//helper function to report one stage
+static void report(const char *name, long samples, double seconds) {
+    printf("{\"bench\": \"%s\", \"samples\": %ld, \"block_size\": %d, \"seconds\": %.6f, "
+        "\"samples_per_sec\": %.0f, \"ns_per_block\": %.1f}\n", name, samples, block_size, seconds,
+        samples / seconds, seconds * 1e9 / ((double) samples / block_size));
+}
+
+int main(int argc, char **argv) {
+    int secs = 600, density = 2, level = 0, noisy = 0, repeat = 5;
+    block_size = DEFAULT_BLOCK_SIZE;
+    int opt;
+    while((opt = getopt(argc, argv, "t:d:l:b:r:S:")) != -1) {
+        switch(opt) {
+        case 't': secs = atoi(optarg); break;
+        case 'd': density = atoi(optarg); break;
+        case 'l': level = atoi(optarg); noisy = 1; break;
+        case 'b': block_size = atoi(optarg); break;
+        case 'r': repeat = atoi(optarg); break;
+        case 'S': seed = strtoul(optarg, NULL, 10); break;
+        default: fprintf(stderr, BENCH_USAGE, *argv); return EXIT_FAILURE;
+        }
+    }
+    if(secs < 1 || secs > (INT32_MAX >> 3) / 1000 || density < 0 || density > 10
+        || block_size < 10 || block_size > 1000 || repeat < 1) {
+        fprintf(stderr, BENCH_USAGE, *argv);
+        return EXIT_FAILURE;
+    }
+    int samples = secs * AUDIO_FRAME_RATE;
+    uint32_t first_seed = seed;
+    hop_size = 0;
+    num_threads = 1;
+
+    //events and audio go in temporary files, so that detection can map its input as usual
+    atexit(remove_temp_files);
+    if(make_temp_file(events_path) != 0 || make_temp_file(audio_path) != 0
+        || (noisy && make_temp_file(noise_path) != 0))
+        return EXIT_FAILURE;
+    FILE *events = open_file(events_path, "w+");
+    if(events == NULL)
+        return EXIT_FAILURE;
+    write_events(events, samples, density);
+    noise_file = NULL;
+    noise_level = level;
+    if(noisy && write_noise(noise_path, samples) == 0)
+        noise_file = noise_path;
+    if(noisy && noise_file == NULL) {
+        fprintf(stderr, "Unable to write the noise file\n");
+        return EXIT_FAILURE;
+    }
+    printf("{\"config\": {\"seconds\": %d, \"density\": %d, \"noise\": %s, \"level\": %d, "
+        "\"block_size\": %d, \"repeat\": %d, \"seed\": %u}}\n", secs, density, noisy ? "true" : "false",
+        level, block_size, repeat, first_seed);
+
+    double best = 1e30;
+    for(int r = 0; r < repeat; r++) {
+        rewind(events);
+        FILE *audio = open_file(audio_path, "w");
+        if(audio == NULL)
+            return EXIT_FAILURE;
+        double t0 = now();
+        int ret = dtmf_generate(events, audio, samples);
+        fflush(audio);
+        double t = now() - t0;
+        fclose(audio);
+        if(ret != 0) {
+            fprintf(stderr, "Generation failed\n");
+            return EXIT_FAILURE;
+        }
+        best = t < best ? t : best;
+    }
+    report("generate", samples, best);
+
+    FILE *audio = open_file(audio_path, "r");
+    if(audio == NULL)
+        return EXIT_FAILURE;
+    AUDIO_HEADER header;
+    best = 1e30;
+    for(int r = 0; r < repeat; r++) {
+        double t0 = now();
+        for(int i = 0; i < HEADER_CALLS; i++) {
+            rewind(audio);
+            audio_read_header(audio, &header);
+        }
+        double t = now() - t0;
+        best = t < best ? t : best;
+    }
+    printf("{\"bench\": \"read_header\", \"calls\": %d, \"seconds\": %.6f, \"ns_per_call\": %.1f}\n",
+        HEADER_CALLS, best, best * 1e9 / HEADER_CALLS);
+
+    static int16_t buf[SAMPLE_BUF_SIZE];
+    best = 1e30;
+    for(int r = 0; r < repeat; r++) {
+        rewind(audio);
+        audio_read_header(audio, &header);
+        double t0 = now();
+        long total = 0;
+        int n;
+        while((n = audio_read_samples(audio, buf, SAMPLE_BUF_SIZE)) > 0)
+            total += n;
+        double t = now() - t0;
+        if(total != samples) {
+            fprintf(stderr, "Read %ld samples, should be %d\n", total, samples);
+            return EXIT_FAILURE;
+        }
+        best = t < best ? t : best;
+    }
+    report("read_samples", samples, best);
+
+    FILE *sink = open_file("/dev/null", "w");
+    if(sink == NULL)
+        return EXIT_FAILURE;
+    best = 1e30;
+    for(int r = 0; r < repeat; r++) {
+        double t0 = now();
+        for(int i = 0; i < samples; i += SAMPLE_BUF_SIZE) {
+            audio_write_samples(sink, buf, samples - i < SAMPLE_BUF_SIZE ? samples - i : SAMPLE_BUF_SIZE);
+        }
+        fflush(sink);
+        double t = now() - t0;
+        best = t < best ? t : best;
+    }
+    report("write_samples", samples, best);
+
+    best = 1e30;
+    for(int r = 0; r < repeat; r++) {
+        //dtmf_detect only maps streams that have not been read from, so each run gets a fresh one
+        FILE *in = open_file(audio_path, "r");
+        if(in == NULL)
+            return EXIT_FAILURE;
+        double t0 = now();
+        int ret = dtmf_detect(in, sink);
+        fflush(sink);
+        double t = now() - t0;
+        fclose(in);
+        if(ret != 0) {
+            fprintf(stderr, "Detection failed\n");
+            return EXIT_FAILURE;
+        }
+        best = t < best ? t : best;
+    }
+    report("detect", samples, best);
+
+    fclose(sink);
+    fclose(audio);
+    fclose(events);
+    return EXIT_SUCCESS;
+}
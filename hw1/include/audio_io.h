@@ -0,0 +1,140 @@
+#ifndef AUDIO_IO_H
+#define AUDIO_IO_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "audio.h"
+
+/*
+ * Audio I/O beyond the one-sample-at-a-time functions of audio.h: block sample I/O,
+ * and files mapped into memory.
+ *
+ * audio_read_header keeps to the audio files that we create (AUDIO_FRAME_RATE and
+ * AUDIO_CHANNELS, as audio.h says).  Detection reads its input with audio_read_header_any
+ * (or audio_map_file) instead, which accept any sample rate from MIN_AUDIO_FRAME_RATE to
+ * MAX_AUDIO_FRAME_RATE, and up to MAX_AUDIO_CHANNELS channels, with the samples of each
+ * frame interleaved.
+ */
+
+/*
+ * Limits on the audio files that we read.  The lowest rate still puts the
+ * highest DTMF frequency (1633 Hz) below the Nyquist frequency.
+ */
+#define MIN_AUDIO_FRAME_RATE 4000
+#define MAX_AUDIO_FRAME_RATE 192000
+#define MAX_AUDIO_CHANNELS 8
+
+/**
+ * @brief Read the header of a Sun audio file and check it for validity, at any rate.
+ * @details  This function reads and checks the header just as audio_read_header does,
+ * except that the sample rate may be anything from MIN_AUDIO_FRAME_RATE to
+ * MAX_AUDIO_FRAME_RATE and there may be from 1 to MAX_AUDIO_CHANNELS channels.
+ *
+ * @param in  Input stream from which the header is to be read.
+ * @param hp  A pointer to the AUDIO_HEADER structure that is to receive the data.
+ * @return  0 if a valid header was read, otherwise EOF.
+ */
+int audio_read_header_any(FILE *in, AUDIO_HEADER *hp);
+
+/**
+ * Read a block of two-byte audio samples from an input stream.
+ * The samples are read with a single bulk read and are then converted
+ * from big-endian to host byte order in one pass over the buffer.
+ *
+ *   @param in  Input stream from which samples are to be read.
+ *   @param samples  Caller-supplied buffer into which to store the sample values.
+ *   @param count  Maximum number of samples to be read.
+ *   @return the number of samples read, which is less than count only if the
+ *   end of the input was reached, or EOF if an error occurred.
+ */
+int audio_read_samples(FILE *in, int16_t *samples, int count);
+
+/**
+ * Write a block of two-byte audio samples to an output stream.
+ * The samples are converted to big-endian byte order in one pass over
+ * the buffer and written with a single bulk write.  The buffer is restored
+ * to host byte order before returning.
+ *
+ *   @param out  Output stream to which samples are to be written.
+ *   @param samples  Caller-supplied buffer containing the samples to be written.
+ *   @param count  Number of samples to be written.
+ *   @return 0 on success, EOF otherwise.
+ */
+int audio_write_samples(FILE *out, int16_t *samples, int count);
+
+/**
+ * Write a run of silent (zero) samples to an output stream.  If the stream is a
+ * regular file that ends where the samples are to be written, the file is just
+ * extended (leaving a hole, which reads back as zeroes) and the stream positioned
+ * past the end, so the cost does not depend on the number of samples.  Otherwise
+ * the zeroes are written in large bulk writes.
+ *
+ *   @param out  Output stream to which samples are to be written.
+ *   @param count  Number of samples to be written.
+ *   @return 0 on success, EOF otherwise.
+ */
+int audio_write_silence(FILE *out, uint32_t count);
+
+/*
+ * Structure describing a Sun audio file that has been mapped into memory.
+ * The sample data is left exactly as it is in the file, so samples are
+ * still in big-endian byte order and must be converted as they are used.
+ */
+typedef struct audio_map {
+    unsigned char *base;     // Start of the mapping (i.e. the first byte of the header).
+    size_t length;           // Length of the mapping, in bytes.
+    int16_t *samples;        // Start of the sample data, at base + data_offset.
+    size_t num_samples;      // Number of complete samples following the data offset.
+} AUDIO_MAP;
+
+/**
+ * @brief Decode the header of a Sun audio file from memory and check it for validity.
+ * @details  This function performs the same decoding and checks as audio_read_header,
+ * but takes the header data from a buffer (typically a memory-mapped file) instead of
+ * from an input stream.
+ *
+ * @param data  Pointer to the first byte of the file.
+ * @param len  Number of bytes available at data.
+ * @param hp  A pointer to the AUDIO_HEADER structure that is to receive the data.
+ * @return  0 if a valid header was decoded, otherwise EOF.
+ */
+int audio_parse_header(const unsigned char *data, size_t len, AUDIO_HEADER *hp);
+
+/**
+ * @brief Decode the header of a Sun audio file from memory and check it for validity, at any rate.
+ * @details  This function performs the same decoding and checks as audio_read_header_any,
+ * but takes the header data from a buffer, as audio_parse_header does.
+ *
+ * @param data  Pointer to the first byte of the file.
+ * @param len  Number of bytes available at data.
+ * @param hp  A pointer to the AUDIO_HEADER structure that is to receive the data.
+ * @return  0 if a valid header was decoded, otherwise EOF.
+ */
+int audio_parse_header_any(const unsigned char *data, size_t len, AUDIO_HEADER *hp);
+
+/**
+ * @brief Map a Sun audio file into memory and check its header for validity.
+ * @details  If the input stream refers to a regular file that has not yet been read from,
+ * the whole file is mapped read-only and its header is decoded and validated straight
+ * from the mapping with audio_parse_header_any.  Streams that cannot be mapped (pipes,
+ * terminals, sockets, or streams that are not positioned at the start) are left untouched
+ * so that the caller can fall back to audio_read_header_any and the block sample I/O functions.
+ *
+ * @param in  Input stream containing the audio file.
+ * @param hp  A pointer to the AUDIO_HEADER structure that is to receive the header.
+ * @param mp  A pointer to the AUDIO_MAP structure that is to describe the mapping.
+ * @return  0 if the file was mapped and has a valid header, 1 if the stream cannot be
+ * mapped, EOF if the file was mapped but its header is not valid.
+ */
+int audio_map_file(FILE *in, AUDIO_HEADER *hp, AUDIO_MAP *mp);
+
+/**
+ * Release a mapping made by audio_map_file.
+ *
+ *   @param mp  The mapping to be released.
+ */
+void audio_unmap_file(AUDIO_MAP *mp);
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef BUFFERS_H
+#define BUFFERS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "audio_io.h"
+#include "goertzel_bank.h"
+#include "events.h"
+#include "detect.h"
+
+/*
+ * Statically allocated buffers used in DTMF generation and detection, beyond those of
+ * const.h.  The const.h buffers only have room for one line of event text and the eight
+ * DTMF filters, which is not enough for block I/O, so dtmf.c does not keep to using those
+ * alone: it also uses the arrays declared here, which are defined in buffers.c.
+ */
+
+/*
+ * Buffer for use in reading DTMF events in text form.  The text is read a buffer at a
+ * time and parsed in place, so lines can be of any length.
+ */
+#define EVENT_TEXT_BUF_SIZE 65536
+extern char event_text_buf[EVENT_TEXT_BUF_SIZE];
+
+/*
+ * Buffer of binary DTMF event records for use in reading DTMF events.
+ */
+#define EVENT_BUF_SIZE 256
+extern EVENT_RECORD event_buf[EVENT_BUF_SIZE];
+
+/*
+ * Buffer of audio samples for use with the block sample I/O functions.
+ */
+#define SAMPLE_BUF_SIZE 1024
+extern int16_t sample_buf[SAMPLE_BUF_SIZE];
+
+/*
+ * Buffer of audio samples for use in DTMF detection: room for a block of up to
+ * MAX_BLOCK_FRAMES frames of up to MAX_AUDIO_CHANNELS samples each as they are read,
+ * followed by room for the same samples de-interleaved into one block per channel.
+ */
+#define DETECT_BUF_SIZE (2 * MAX_BLOCK_FRAMES * MAX_AUDIO_CHANNELS)
+extern int16_t detect_buf[DETECT_BUF_SIZE];
+
+/*
+ * Statically allocated detection state (filters, strengths and event in progress)
+ * for each channel of the audio being analyzed.
+ */
+extern DETECT_CHANNEL detect_channels[MAX_AUDIO_CHANNELS];
+
+/*
+ * Tables used in DTMF generation.  Every DTMF frequency is a whole number of Hz, so the
+ * value of a tone at any sample index can be looked up in a single table holding half
+ * of one period of cos() at each of the AUDIO_FRAME_RATE possible phases.  Synthesized
+ * samples are built up a buffer at a time in tone_buf before being written out.
+ */
+extern double cos_table[AUDIO_FRAME_RATE];
+extern double tone_buf[SAMPLE_BUF_SIZE];
+
+/*
+ * Gaps between events of at least this many samples are written with audio_write_silence
+ * (when there is no noise to mix in) rather than a buffer of zeroes at a time.
+ */
+#define SILENCE_BULK_SAMPLES (4 * SAMPLE_BUF_SIZE)
+
+/*
+ * Buffer of samples read from the noise file, to be mixed into tone_buf.
+ */
+extern int16_t noise_buf[SAMPLE_BUF_SIZE];
+
+/*
+ * Statically allocated state objects for sliding Goertzel filter instances,
+ * one for each frequency of the tone profile on each channel, and the window of samples they
+ * currently cover on each channel (used as a circular buffer).  These are used
+ * in place of the Goertzel filters when detection is done with overlapping blocks.
+ */
+extern SLIDING_GOERTZEL_STATE sliding_state[MAX_AUDIO_CHANNELS][MAX_TONE_FREQS];
+extern int16_t window_buf[MAX_AUDIO_CHANNELS][MAX_BLOCK_FRAMES];
+
+/*
+ * Statically allocated state for parallel detection: the worker threads, a buffer
+ * holding the samples of the round of blocks currently being analyzed (when they
+ * come from a stream rather than a mapped file), and the decisions for those blocks.
+ */
+#define MAX_DETECT_THREADS 64
+#define DETECT_ROUND_SAMPLES (1 << 20)
+#define DETECT_ROUND_BLOCKS (DETECT_ROUND_SAMPLES / 10)
+extern DETECT_WORKER detect_workers[MAX_DETECT_THREADS];
+extern int16_t round_buf[DETECT_ROUND_SAMPLES];
+extern DTMF_DECISION decision_buf[DETECT_ROUND_BLOCKS];
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include <stdint.h>
+
+/*
+ * Low-pass decimation front end for DTMF detection on high-rate audio.
+ *
+ * DTMF energy lies entirely below DECIMATE_PASS_EDGE Hz, so audio sampled well above
+ * 8000 Hz can be low-pass filtered and then only every M'th sample kept, after which
+ * the Goertzel filters have M times fewer samples to process.  The filter is a
+ * windowed-sinc (Hamming) FIR filter, and only the outputs that are kept are ever
+ * computed (the polyphase form of the filter), so the cost of filtering is about
+ * L/M multiply-adds per input sample for an L-tap filter.  As with the Goertzel bank,
+ * the filter runs four taps at a time with AVX2 (and fused multiply-adds) when the CPU has it.
+ *
+ * Accuracy trade-off: the filter is designed so that anything that would alias onto
+ * the DTMF band is attenuated by at least about 50 dB, and the passband ripple is
+ * well under 0.1 dB, which is far inside the 4 dB and 6 dB margins used by check_tone.
+ * The filter delays the signal by (L-1)/2 input samples, so event boundaries come out
+ * up to that many samples later than without decimation (a few samples at 16 kHz,
+ * under twenty at 48 kHz), and decimated samples are rounded back to 16 bits.
+ */
+
+#define DECIMATE_PASS_EDGE 1700
+#define DECIMATE_MAX_TAPS 160
+#define DECIMATE_MAX_BLOCK 1024
+
+/*
+ * State of an instance of the decimator.  The input samples are kept in x as doubles,
+ * the last L-1 samples of the previous block followed by the samples of the current one,
+ * so that the filter can run straight across the boundary between blocks.
+ */
+typedef struct decimator {
+    int M;                                     // Decimation factor.
+    int L;                                     // Number of filter taps.
+    double h[DECIMATE_MAX_TAPS];               // Filter taps (symmetric, so order does not matter).
+    double x[DECIMATE_MAX_TAPS + DECIMATE_MAX_BLOCK];
+    double y[DECIMATE_MAX_BLOCK / 2];          // Filter outputs for the current block.
+} DECIMATOR;
+
+/*
+ * Choose the decimation factor to be used for audio at a given rate analyzed in blocks
+ * of N samples: the largest M that divides both N and the rate and leaves a rate of at
+ * least 8000 samples per second, so that every block decimates to exactly N/M samples.
+ *
+ *   @param rate  The sample rate of the audio.
+ *   @param N  The number of samples in each block.
+ *   @return  The decimation factor, which is 1 if the audio cannot usefully be decimated.
+ */
+int decimate_factor(uint32_t rate, int N);
+
+/*
+ * Initialize an instance of the decimator, designing its filter and clearing its history.
+ *
+ *   @param dp  Pointer to the decimator.
+ *   @param rate  The sample rate of the audio to be decimated.
+ *   @param M  The decimation factor.
+ */
+void decimator_init(DECIMATOR *dp, uint32_t rate, int M);
+
+/*
+ * Filter and decimate the next block of samples.
+ *
+ *   @param dp  Pointer to the decimator.
+ *   @param samples  Samples to be decimated.
+ *   @param count  Number of samples, a multiple of M and at most DECIMATE_MAX_BLOCK.
+ *   @param big_endian  Nonzero if the samples are in big-endian byte order
+ *   (i.e. straight from an audio file), zero if they are in host byte order.
+ *   @param out  Buffer into which to store the count/M decimated samples (in host byte order).
+ */
+void decimator_run(DECIMATOR *dp, const int16_t *samples, int count, int big_endian, int16_t *out);
+
+#endif
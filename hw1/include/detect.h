@@ -0,0 +1,172 @@
+#ifndef DETECT_H
+#define DETECT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "audio.h"
+#include "audio_io.h"
+#include "dtmf.h"
+#include "goertzel.h"
+#include "decimate.h"
+#include "events.h"
+#include "tones.h"
+
+/*
+ * Internal interfaces shared by the source files that make up the DTMF detector.
+ */
+
+/*
+ * Settings that the analysis of a stream depends on.  Everything that decides blocks or builds
+ * up events takes them from here rather than from the process-wide settings, so streams with
+ * different settings can be analyzed at once.  dtmf -d fills detect_options in from its own
+ * settings (see get_detect_options); a DTMF_DETECTOR carries its own.
+ */
+typedef struct detect_options {
+    const TONE_PROFILE *profile; // Tones and thresholds.
+    int fixed_point;             // Nonzero to run the filters in fixed point.
+    int all_strengths;           // Nonzero to run the filters even for quiet blocks (whose strengths telemetry reports).
+    int onsets;                  // Nonzero to write out the start of each event as soon as it is long enough (real time).
+} DETECT_OPTIONS;
+
+extern DETECT_OPTIONS detect_options;
+
+/*
+ * State of the DTMF event currently being built up during detection.
+ * Sample indices are 64 bits wide, so that an unbounded input stream cannot overflow them.
+ * For multi-channel audio the indices are frame indices, and there is one event per channel.
+ */
+typedef struct event_state {
+    char symbol;
+    char prev_symbol;
+    int64_t s_index;
+    int64_t e_index;
+    int64_t position;   // Number of samples read when the latest decision was made.
+    int channel;        // Channel on which the event occurs, or -1 if the audio is monaural.
+    uint32_t rate;      // Sample rate of the audio, used to find the duration of the event.
+    double row_total;   // Sums of the row and column strengths over the decisions making up
+    double col_total;   // the event, and the number of those decisions, for binary output.
+    int64_t decisions;
+    int open;           // Nonzero once the onset of the event has been written out (in real-time mode).
+    void (*emit)(void *, const EVENT_RECORD *);  // If not NULL, called with each completed event (and
+    void *emit_arg;                              // emit_arg) in place of writing it to the stream.
+    const DETECT_OPTIONS *options;               // Settings of the analysis.
+} EVENT_STATE;
+
+/*
+ * Return values of check_tone: a tone was found, or else the reason it was not.  The
+ * thresholds are those of the tone profile; the ones given are those of DTMF.  For a
+ * pair table, the "row" and "column" are the strongest and second strongest tones.
+ */
+#define TONE_FOUND 0
+#define TONE_WEAK (-1)       // The strongest row and column together are below -20 dB.
+#define TONE_TWIST (-2)      // The strongest row and column differ by more than 4 dB.
+#define TONE_ROW (-3)        // Some other row is within 6 dB of the strongest one.
+#define TONE_COLUMN (-4)     // Some other column is within 6 dB of the strongest one.
+#define TONE_NONE (-5)       // No symbol is made up of the two strongest tones.
+
+/*
+ * Outcome of check_tone for one block of samples.  Decisions are recorded so that
+ * blocks can be analyzed out of order (e.g. by several threads at once) and the
+ * DTMF events built up from them afterwards, in order.
+ */
+typedef struct dtmf_decision {
+    int tone;           // Return value of check_tone.
+    double sum;         // Sum of the strongest row and column strengths.
+    int str_row_index;  // Index (into the frequencies of the tone profile) of the strongest row frequency.
+    int str_col_index;  // Index (into the frequencies of the tone profile) of the strongest column frequency.
+    double row_strength; // Strength of the strongest row frequency.
+    double col_strength; // Strength of the strongest column frequency.
+} DTMF_DECISION;
+
+/*
+ * Detection state for one channel of the audio being analyzed.
+ */
+typedef struct detect_channel {
+    GOERTZEL_STATE states[MAX_TONE_FREQS];
+    double strengths[MAX_TONE_FREQS];
+    EVENT_STATE event;
+    DECIMATOR decimator;       // Used only if the audio is decimated before analysis.
+} DETECT_CHANNEL;
+
+/*
+ * Per-thread state for a worker thread used in parallel or batch detection.
+ * Each worker has its own filters, so workers never share anything but
+ * the (read-only) samples and their own slots in the decision buffer.
+ * Parallel detection only uses the first channel.
+ */
+typedef struct detect_worker {
+    pthread_t thread;
+    int index;                                // Which slice of each round this worker analyzes.
+    unsigned long round;                      // Last round this worker has seen.
+    DETECT_CHANNEL channels[MAX_AUDIO_CHANNELS];
+} DETECT_WORKER;
+
+/*
+ * Get sample i of a block, converting it from big-endian if it came straight from a file.
+ */
+static inline int16_t block_sample(const int16_t *block, int i, int big_endian) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if(big_endian)
+        return (int16_t) __builtin_bswap16(*(block + i));
+#endif
+    return *(block + i);
+}
+
+/*
+ * Block sizes (block_size and hop_size) count samples at AUDIO_FRAME_RATE, so that a block
+ * covers the same span of time whatever the rate of the audio.  They are scaled to the rate
+ * in the header of each input with block_frames, so buffers of blocks have room for
+ * MAX_BLOCK_FRAMES frames.
+ */
+#define MIN_BLOCK_SIZE 10
+#define MAX_BLOCK_SIZE 1000
+#define MAX_BLOCK_FRAMES (MAX_BLOCK_SIZE * (MAX_AUDIO_FRAME_RATE / AUDIO_FRAME_RATE))
+
+int block_frames(int size, uint32_t rate);
+int check_rate(uint32_t rate);
+void get_detect_options(DETECT_OPTIONS *op);
+void setup_filters(GOERTZEL_STATE *states, int N, uint32_t rate, const TONE_PROFILE *tp);
+void compute_strengths(const int16_t *block, int N, int big_endian, GOERTZEL_STATE *states,
+    double *strengths, const DETECT_OPTIONS *op);
+int check_tone(double *strengths, double *sum, int *str_row_index, int *str_col_index, const TONE_PROFILE *tp);
+void decide_block(const int16_t *block, int N, uint32_t rate, int big_endian, GOERTZEL_STATE *states,
+    double *strengths, const DETECT_OPTIONS *op, DTMF_DECISION *dp);
+void init_event(EVENT_STATE *ep, int channel, uint32_t rate, const DETECT_OPTIONS *op);
+void decide_strengths(double *strengths, const TONE_PROFILE *tp, DTMF_DECISION *dp);
+int update_event(EVENT_STATE *ep, const DTMF_DECISION *dp, int step, FILE *events_out);
+void finish_event(EVENT_STATE *ep, int64_t samples_read, FILE *events_out);
+int open_audio(FILE *audio_in, AUDIO_HEADER *hp, AUDIO_MAP *map, AUDIO_MAP **mapp);
+int detect_blocks(FILE *audio_in, AUDIO_HEADER *hp, AUDIO_MAP *map, FILE *events_out,
+    DETECT_CHANNEL *channels, int16_t *buf);
+
+/*
+ * Detection over non-overlapping blocks, with the blocks analyzed by num_threads
+ * worker threads.  The output is identical to that of single-threaded detection.
+ *
+ *   @param audio_in  Input stream from which to read sample data (positioned after the header).
+ *   @param hp  The header of the input, which must be monaural.
+ *   @param map  The mapped input file, or NULL if samples are to be read from audio_in.
+ *   @param events_out  Output stream to which DTMF events are to be written.
+ *   @return 0 if successful, EOF otherwise.
+ */
+int detect_parallel(FILE *audio_in, AUDIO_HEADER *hp, AUDIO_MAP *map, FILE *events_out);
+
+/*
+ * Two-pass detection: a scan over non-overlapping blocks of block_size frames, then, only
+ * around the boundaries found by the scan, analysis in steps of block_size / coarse_factor
+ * frames, each decided by a window of block_size frames centered on it.  Event boundaries
+ * are about as precise as those of detect_sliding with that hop, at close to the cost of
+ * the scan alone.
+ *
+ *   @param audio_in  Input stream from which to read sample data (positioned after the header).
+ *   @param hp  The header of the input.
+ *   @param map  The mapped input file, or NULL if samples are to be read from audio_in, in
+ *   which case (as with more than one channel) ordinary detection is done instead.
+ *   @param events_out  Output stream to which DTMF events are to be written.
+ *   @return 0 if successful, EOF otherwise.
+ */
+int detect_coarse(FILE *audio_in, AUDIO_HEADER *hp, AUDIO_MAP *map, FILE *events_out);
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef DETECTOR_H
+#define DETECTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "audio.h"
+#include "audio_io.h"
+#include "detect.h"
+#include "events.h"
+
+/*
+ * Reentrant DTMF detector, for programs that analyze many streams at once (e.g. one per
+ * call in a long-running service) rather than one audio file per process.
+ *
+ * A DTMF_DETECTOR holds everything needed to analyze one stream: its settings (with its
+ * own copy of the tone profile), its filters, the event in progress on each channel, and
+ * the samples of the block being filled.  The storage for these is allocated by
+ * dtmf_detector_init just for the number of channels, block size and tones given, and is
+ * released by dtmf_detector_destroy.  Samples are pushed in as they arrive, in buffers of
+ * any size (not even whole frames are needed), and each event is handed to a callback as
+ * soon as its end is detected, as an EVENT_RECORD just like those of the binary events
+ * format.  No global state is read or changed, so any number of detectors can be used at
+ * once, each from its own thread and each with its own settings.
+ *
+ * Detection is the same as dtmf -d with non-overlapping blocks (and the events are the
+ * same): each block of block_size frames is analyzed on each channel.  Unlike -b, block_size
+ * counts frames at the rate of the detector; block_frames gives the number matching a -b value.
+ */
+
+/*
+ * Function called with each completed event, and the argument given to dtmf_detector_init.
+ * The record is only valid for the duration of the call.
+ */
+typedef void (*DETECTOR_CALLBACK)(void *arg, const EVENT_RECORD *rp);
+
+#define DETECTOR_MAX_BLOCK MAX_BLOCK_FRAMES
+
+/*
+ * A detector.  The storage it points to is all one allocation, which starts at options.
+ */
+typedef struct dtmf_detector {
+    uint32_t rate;              // Sample rate of the audio.
+    int channels;               // Number of channels of the audio.
+    int block_size;             // Frames per block.
+    int64_t frames;             // Number of frames analyzed so far.
+    int pending;                // Number of samples (not frames) waiting in block_buf.
+    int finished;               // Nonzero once dtmf_detector_finish has been called.
+    DETECT_OPTIONS *options;    // Settings of the analysis, whose profile is a copy of the one given.
+    EVENT_STATE *events;        // Event in progress on each channel.
+    GOERTZEL_STATE *states;     // Filters of each channel, one for each frequency of the profile.
+    double *strengths;          // Latest strengths on each channel, likewise.
+    int16_t *block_buf;         // Interleaved frames of the block being filled (channels * block_size samples).
+    int16_t *channel_buf;       // One channel of a block, de-interleaved (block_size samples).
+} DTMF_DETECTOR;
+
+/**
+ * Initialize a detector for a new stream, allocating its storage.
+ *
+ *   @param dp  The detector to be initialized.
+ *   @param rate  Sample rate of the audio, which must be more than twice the highest
+ *   frequency of the tone profile.
+ *   @param channels  Number of channels, in the range [1, MAX_AUDIO_CHANNELS].
+ *   @param block_size  Frames per block, in the range [10, DETECTOR_MAX_BLOCK].
+ *   @param options  Settings of the analysis: the tone profile (which is copied, so it need
+ *   not be kept) and whether the filters are run in fixed point.  The other settings only
+ *   matter to events written out by dtmf -d, and are not used.
+ *   @param callback  Function to be called with each completed event.
+ *   @param arg  Argument to be passed to the callback.
+ *   @return 0 if successful, -1 if any of the parameters is not valid or the storage
+ *   cannot be allocated.
+ */
+int dtmf_detector_init(DTMF_DETECTOR *dp, uint32_t rate, int channels, int block_size,
+    const DETECT_OPTIONS *options, DETECTOR_CALLBACK callback, void *arg);
+
+/**
+ * Push samples into a detector.  Every whole block that is completed is analyzed at once,
+ * and any events it ends are passed to the callback before this returns.
+ *
+ *   @param dp  The detector.
+ *   @param samples  Samples, in host byte order, with the channels of each frame interleaved.
+ *   The first sample continues the frame left off by the previous push, if it was partial.
+ *   @param count  Number of samples (not frames).
+ *   @return 0 if successful, -1 if the detector has been finished.
+ */
+int dtmf_detector_push(DTMF_DETECTOR *dp, const int16_t *samples, size_t count);
+
+/**
+ * Signal the end of the stream: the last (partial) block is analyzed, padded with silence,
+ * and the event in progress (if any, and long enough) is passed to the callback.  A partial
+ * frame at the end is dropped.
+ *
+ *   @param dp  The detector.
+ *   @return 0 if successful, -1 if the detector has already been finished.
+ */
+int dtmf_detector_finish(DTMF_DETECTOR *dp);
+
+/**
+ * Release the storage of a detector, finished or not.  The detector can then be
+ * initialized again for another stream.
+ *
+ *   @param dp  The detector.
+ */
+void dtmf_detector_destroy(DTMF_DETECTOR *dp);
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Binary DTMF event format, an alternative to the textual tab-separated lines
+ * "start\tend\tsymbol" for large event sets, where formatting and parsing the text
+ * costs more than the events are worth.
+ *
+ * The stream begins with an 8-byte header: the four ASCII characters ".evt"
+ * (EVENTS_MAGIC), then the format version (EVENTS_VERSION) and the size of each
+ * record in bytes (EVENT_RECORD_SIZE), both as 16-bit little-endian values.
+ * The header is followed by any number of fixed-size records, with every field
+ * stored in little-endian byte order:
+ *
+ * +-------+-------+--------------+--------------+---------+--------+----------+
+ * | start | end   | row strength | col strength | channel | symbol | reserved |
+ * | int64 | int64 | float32      | float32      | int8    | char   | 6 bytes  |
+ * +-------+-------+--------------+--------------+---------+--------+----------+
+ *   0       8       16             20             24        25       26
+ *
+ * Start and end are sample (frame) indices, as in the textual format.  The strengths
+ * are the strengths of the row and column frequencies of the symbol, averaged over the
+ * blocks that make up the event.  The channel is -1 for monaural audio.  Reserved bytes
+ * are written as zero.
+ *
+ * In real-time detection (dtmf -d -r), each event is preceded by an onset record, written as
+ * soon as the event is long enough to count: the same start and symbol, the strengths so far,
+ * and an end of EVENT_OPEN_END.  The record for the whole event follows once it has ended.
+ * Onset records are only ever written in real-time mode, and have to be dropped before the
+ * events are used for generation.
+ *
+ * Records are 8-byte aligned within a file, and on a little-endian host the layout of
+ * EVENT_RECORD is exactly that of a record, so a whole events file can be mapped into
+ * memory and used as an array of EVENT_RECORD starting EVENT_HEADER_SIZE bytes in.
+ */
+
+#define EVENTS_MAGIC ".evt"
+#define EVENTS_VERSION 1
+#define EVENT_HEADER_SIZE 8
+#define EVENT_RECORD_SIZE 32
+#define EVENT_OPEN_END (-1)
+
+typedef struct event_record {
+    int64_t start;
+    int64_t end;
+    float row_strength;
+    float col_strength;
+    int8_t channel;
+    char symbol;
+    uint8_t reserved[6];
+} EVENT_RECORD;
+
+_Static_assert(sizeof(EVENT_RECORD) == EVENT_RECORD_SIZE, "EVENT_RECORD must match the file format");
+
+/**
+ * Write the header of a binary events stream.
+ *
+ *   @param out  Output stream to which the header is to be written.
+ *   @return 0 on success, EOF otherwise.
+ */
+int events_write_header(FILE *out);
+
+/**
+ * Read the header of a binary events stream and check it for validity.
+ *
+ *   @param in  Input stream from which the header is to be read.
+ *   @return 0 if a valid header was read, EOF otherwise.
+ */
+int events_read_header(FILE *in);
+
+/**
+ * Write a single event record.  The record is converted to little-endian
+ * byte order as it is written; the caller's copy is left as it is.
+ *
+ *   @param out  Output stream to which the record is to be written.
+ *   @param rp  The record to be written.
+ *   @return 0 on success, EOF otherwise.
+ */
+int events_write_record(FILE *out, const EVENT_RECORD *rp);
+
+/**
+ * Read a block of event records with a single bulk read, converting them
+ * to host byte order.
+ *
+ *   @param in  Input stream from which records are to be read.
+ *   @param records  Caller-supplied buffer into which to store the records.
+ *   @param count  Maximum number of records to be read.
+ *   @return the number of records read, which is less than count only if the end
+ *   of the input was reached, or EOF if an error occurred or the input ends partway
+ *   through a record.
+ */
+int events_read_records(FILE *in, EVENT_RECORD *records, int count);
+
+#endif
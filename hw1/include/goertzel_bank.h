@@ -0,0 +1,242 @@
+#ifndef GOERTZEL_BANK_H
+#define GOERTZEL_BANK_H
+
+#include <stdint.h>
+
+#include "goertzel.h"
+
+/*
+ * Faster ways of running the Goertzel filters of goertzel.h: resetting filters for reuse,
+ * sliding filters, banks of filters stepped together (in double precision or in fixed
+ * point), block energies, and a shared cache of filter coefficients.
+ *
+ * goertzel_strength needs cos(A), sin(A), cos(A(N-1)) and sin(A(N-1)) for each filter.
+ * Rather than working these out for every block, each thread keeps the values for the
+ * last few (A, N) it has seen, so they are only worked out again when a filter changes.
+ */
+
+/*
+ * Reset the state variables of an instance of the Goertzel algorithm, so that
+ * it can be used to analyze another N samples with the same N and k.
+ * The constants computed by goertzel_init are kept, so this is much cheaper
+ * than calling goertzel_init again for each block of samples.
+ *
+ *   @param gp  Pointer to structure previously initialized by goertzel_init.
+ */
+void goertzel_reset(GOERTZEL_STATE *gp);
+
+/*
+ * Structure representing the state of a "sliding" instance of the Goertzel algorithm,
+ * which tracks the value y of the DTFT (at the frequency index k) of the most recent
+ * N samples of a signal, rather than of one fixed block of N samples.
+ * Each time a new sample x_new enters the window and the oldest sample x_old leaves it,
+ * the value is updated recursively:
+ *
+ *   y <- e^jA (y - x_old) + x_new e^-jA(N-1)
+ *
+ * which costs a constant amount of work per sample regardless of N.  With the window
+ * aligned to a block, y is the same value as that computed by goertzel_strength.
+ * The recursion is only marginally stable, but rounding error grows only with the square
+ * root of the number of samples, which leaves it many orders of magnitude below the
+ * DTMF detection thresholds even for streams that are hours long.
+ */
+typedef struct sliding_goertzel_state {
+    uint32_t N;      // Number of samples in the window.
+    double k;        // Real-valued "index" of the frequency component.
+    double cos_A;    // e^jA, applied at each step.
+    double sin_A;
+    double cos_AN;   // e^-jA(N-1), applied to the incoming sample.
+    double sin_AN;
+    double re;       // Real and imaginary parts of y for the current window.
+    double im;
+} SLIDING_GOERTZEL_STATE;
+
+/*
+ * Initialize the state of a sliding instance of the Goertzel algorithm, with a window
+ * that initially contains N zero samples.
+ *
+ *   @param sp  Pointer to structure to be initialized.
+ *   @param N  Number of samples in the window.
+ *   @param k  Real-valued "index" of the frequency component, as for goertzel_init.
+ */
+void sliding_goertzel_init(SLIDING_GOERTZEL_STATE *sp, uint32_t N, double k);
+
+/*
+ * Slide the window of a sliding Goertzel instance along by one sample.
+ *
+ *   @param sp  Pointer to structure containing the algorithm state.
+ *   @param x_new  The sample entering the window.
+ *   @param x_old  The sample leaving the window (i.e. the sample N samples before x_new).
+ */
+void sliding_goertzel_step(SLIDING_GOERTZEL_STATE *sp, double x_new, double x_old);
+
+/*
+ * Get the "strength" 2|y|^2/N^2 of the frequency component for the current window,
+ * on the same scale as goertzel_strength.
+ *
+ *   @param sp  Pointer to structure containing the algorithm state.
+ *   @return  The strength for the N samples currently in the window.
+ */
+double sliding_goertzel_strength(SLIDING_GOERTZEL_STATE *sp);
+
+/*
+ * Structure representing a bank of Goertzel filter instances that are all
+ * stepped with the same input samples.  The multiplicative constants and state
+ * variables of the filters are stored "structure of arrays" style, so that the
+ * main loop of the algorithm can update several filters at once in SIMD lanes
+ * (four lanes of two doubles with SSE2, two lanes of four doubles with AVX2).
+ * The filters are stepped a group of GOERTZEL_BANK_GROUP at a time, which is all
+ * of them for the usual eight DTMF frequencies; unused lanes of the last group are
+ * zero and are simply carried along.
+ */
+#define GOERTZEL_BANK_SIZE 16
+#define GOERTZEL_BANK_GROUP 8
+
+typedef struct goertzel_bank {
+    double B[GOERTZEL_BANK_SIZE] __attribute__((aligned(32)));
+    double s1[GOERTZEL_BANK_SIZE] __attribute__((aligned(32)));
+    double s2[GOERTZEL_BANK_SIZE] __attribute__((aligned(32)));
+    int n;           // Number of filter instances in use.
+} GOERTZEL_BANK;
+
+/*
+ * Gather the constants and state of n (at most GOERTZEL_BANK_SIZE) Goertzel
+ * filter instances into a bank.
+ *
+ *   @param bp  Pointer to the bank to be loaded.
+ *   @param gp  Pointer to the first of n consecutive filter instances.
+ *   @param n  Number of filter instances.
+ */
+void goertzel_bank_load(GOERTZEL_BANK *bp, GOERTZEL_STATE *gp, int n);
+
+/*
+ * Scatter the state variables of a bank back into the filter instances it was
+ * loaded from, so that goertzel_strength can be used to finish each of them.
+ *
+ *   @param bp  Pointer to the bank.
+ *   @param gp  Pointer to the first of the filter instances the bank was loaded from.
+ */
+void goertzel_bank_store(GOERTZEL_BANK *bp, GOERTZEL_STATE *gp);
+
+/*
+ * Perform count iterations of the main loop of the Goertzel algorithm on every
+ * filter in a bank.  This is equivalent to calling goertzel_step on each filter
+ * instance with x = sample / INT16_MAX for each sample in turn.  The operations
+ * are performed in the same order as in goertzel_step, so the results are
+ * bit-identical to the scalar path unless the compiler contracts the scalar code
+ * into fused multiply-adds (e.g. with -march=native), in which case they agree
+ * to within a relative error of 1e-12.  The widest kernel supported by the CPU
+ * is selected at run time, and a plain scalar loop is used on other machines.
+ *
+ *   @param bp  Pointer to the bank.
+ *   @param samples  Samples to be processed.
+ *   @param count  Number of samples to be processed.
+ *   @param big_endian  Nonzero if the samples are in big-endian byte order
+ *   (i.e. straight from an audio file), zero if they are in host byte order.
+ */
+void goertzel_bank_run(GOERTZEL_BANK *bp, const int16_t *samples, int count, int big_endian);
+
+/*
+ * Fixed-point counterpart of GOERTZEL_BANK, for machines where integer arithmetic is
+ * cheaper than double precision.  The samples are used just as they are read, as Q15
+ * values (16-bit integers standing for fractions in [-1, 1)), the state variables are
+ * Q15 values held in 32-bit integers, and each multiplicative constant B = 2cos(A) is
+ * held as cos(A) in Q31 format (a 32-bit integer scaled by 2^31).  One step is then
+ *
+ *     s0 = x + ((c * s1) >> 30) - s2
+ *
+ * worked out in 64 bits (the product alone can be twice the state) and narrowed to 32 bits
+ * once.  The state grows by at most 1/sin(A) times the largest sample per step, and
+ * goertzel_fixed_bank_load refuses any filter for which that could take it past 1.5 * 2^30
+ * over a block (frequencies close to zero or to the Nyquist frequency, or long blocks at
+ * high rates), so s0 always fits.
+ * The state is converted back to double precision when it is stored, so
+ * goertzel_strength can finish each filter as usual.  The result differs from that of
+ * the double precision bank by the rounding of c and of each product, which is a relative
+ * error of about 2^-31 per step, far too small to change a tone decision.
+ */
+typedef struct goertzel_fixed_bank {
+    int32_t c[GOERTZEL_BANK_SIZE] __attribute__((aligned(32)));
+    int32_t s1[GOERTZEL_BANK_SIZE] __attribute__((aligned(32)));
+    int32_t s2[GOERTZEL_BANK_SIZE] __attribute__((aligned(32)));
+    int n;           // Number of filter instances in use.
+} GOERTZEL_FIXED_BANK;
+
+/*
+ * Gather the constants and state of n (at most GOERTZEL_BANK_SIZE) Goertzel
+ * filter instances into a fixed-point bank.
+ *
+ *   @param bp  Pointer to the bank to be loaded.
+ *   @param gp  Pointer to the first of n consecutive filter instances.
+ *   @param n  Number of filter instances.
+ *   @return 0 if successful, -1 if the state of some filter could overflow 32 bits
+ *   over a block, in which case the double precision bank has to be used instead.
+ */
+int goertzel_fixed_bank_load(GOERTZEL_FIXED_BANK *bp, GOERTZEL_STATE *gp, int n);
+
+/*
+ * Scatter the state variables of a fixed-point bank back into the filter instances
+ * it was loaded from, converted to double precision.
+ *
+ *   @param bp  Pointer to the bank.
+ *   @param gp  Pointer to the first of the filter instances the bank was loaded from.
+ */
+void goertzel_fixed_bank_store(GOERTZEL_FIXED_BANK *bp, GOERTZEL_STATE *gp);
+
+/*
+ * Step every filter in a fixed-point bank with each of count samples in turn.
+ * As with goertzel_bank_run, an AVX2 kernel (a group of eight filters in one vector) is
+ * used if the CPU supports it; it gives exactly the same results as the scalar loop.
+ *
+ *   @param bp  Pointer to the bank.
+ *   @param samples  Samples to be processed.
+ *   @param count  Number of samples to be processed.
+ *   @param big_endian  Nonzero if the samples are in big-endian byte order
+ *   (i.e. straight from an audio file), zero if they are in host byte order.
+ */
+void goertzel_fixed_bank_run(GOERTZEL_FIXED_BANK *bp, const int16_t *samples, int count, int big_endian);
+
+/*
+ * Compute the energy of a block of samples: the sum of the squares of the samples,
+ * exactly, in the units of the samples themselves.  This is much cheaper than running
+ * a bank of filters, and bounds what the filters can find: by the Cauchy-Schwarz
+ * inequality |y|^2 <= N * sum(x^2), so the strength of any one frequency over the
+ * block is at most 2 * energy / (N * INT16_MAX^2).  Blocks too quiet for a tone can
+ * therefore be passed over without running the filters at all.  On x86-64 the sum is
+ * taken eight samples at a time with SSE2.
+ *
+ *   @param samples  Samples of the block.
+ *   @param count  Number of samples in the block.
+ *   @param big_endian  Nonzero if the samples are in big-endian byte order
+ *   (i.e. straight from an audio file), zero if they are in host byte order.
+ *   @return  The sum of the squares of the samples.
+ */
+uint64_t goertzel_block_energy(const int16_t *samples, int count, int big_endian);
+
+/*
+ * Shared cache of filter coefficients.  The constants of a filter (B, and the sines and
+ * cosines used to finish it) only depend on the sample rate, the block size and the
+ * frequency, but they take a cos and a sin or two each to work out.  The cache holds
+ * a set of filter instances for each (sample rate, block size, frequency table) that
+ * has been asked for, each worked out once with goertzel_init and never changed
+ * afterwards, so that any number of threads and detectors can share them: a filter
+ * only needs to be copied from the cache when its block size or frequency changes,
+ * and otherwise just reset.  Entries are never removed; once GOERTZEL_CACHE_SIZE of
+ * them are in use, no more are added.
+ */
+#define GOERTZEL_CACHE_SIZE 32
+
+/*
+ * Look up (or work out, the first time) the filters for a frequency table.
+ * This is safe to call from any number of threads at once.
+ *
+ *   @param rate  Sample rate of the signal.
+ *   @param N  Number of samples in the signal to be analyzed.
+ *   @param freqs  Frequencies, in Hz, of the filters.
+ *   @param count  Number of frequencies, at most GOERTZEL_BANK_SIZE.
+ *   @return  Pointer to count filter instances, freshly reset and not to be changed,
+ *   for the frequencies in order, or NULL if the cache is full.
+ */
+const GOERTZEL_STATE *goertzel_cache_lookup(uint32_t rate, uint32_t N, const int *freqs, int count);
+
+#endif
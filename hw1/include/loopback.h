@@ -0,0 +1,35 @@
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * In-process loopback of generation into detection, for round-trip testing without
+ * writing any audio to disk.
+ *
+ * dtmf_generate runs on a thread of its own, writing its audio (header and all) to a
+ * stream whose only backing is a fixed-size ring of LOOPBACK_RING_SIZE bytes, while
+ * dtmf_detect reads the same audio back out of the ring on the calling thread.  The
+ * generator waits whenever the ring is full and the detector whenever it is empty, so
+ * memory use is bounded however long the audio is, and nothing is allocated per run
+ * beyond the two FILE objects (the ring and the stdio buffers are static).
+ *
+ * All the generation and detection options apply just as they would to dtmf -g and
+ * dtmf -d, except that the audio can only be read as a stream, never mapped.
+ */
+
+#define LOOPBACK_RING_SIZE (1 << 16)
+#define LOOPBACK_STREAM_BUF_SIZE 4096
+
+/**
+ * Generate audio from DTMF events and detect the DTMF events in it, in one process.
+ *
+ *   @param events_in  Stream from which the DTMF events to be generated are read.
+ *   @param events_out  Stream to which the detected DTMF events are written.
+ *   @param len  Number of samples of audio to be generated.
+ *   @return 0 if both generation and detection succeed, EOF otherwise.
+ */
+int dtmf_loopback(FILE *events_in, FILE *events_out, uint32_t len);
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "const.h"
+
+/*
+ * Options beyond those of const.h, set by validargs along with the ones there.
+ */
+
+/*
+ * Usage message covering all the options; used in place of USAGE.
+ */
+#define DTMF_USAGE(program_name, retcode) do { \
+fprintf(stderr, "USAGE: %s %s\n", program_name, \
+"[-h] -g|-d|-L [-t MSEC] [-n NOISE_FILE] [-l LEVEL] [-E] [-P PROFILE] [-b BLOCKSIZE] [-s HOP] [-j THREADS] [-B LIST] [-T FILE] [-C FACTOR] [-r] [-D] [-F]\n" \
+"   -h       Help: displays this help menu.\n" \
+"   -g       Generate: read DTMF events from standard input, output audio data to standard output.\n" \
+"   -d       Detect: read audio data from standard input, output DTMF events to standard output.\n" \
+"   -L       Loopback: read DTMF events from standard input, generate audio from them and detect\n" \
+"            the DTMF events in it in the same process (on two threads, through a bounded ring in\n" \
+"            memory, with no audio written out), output DTMF events to standard output.  Takes the\n" \
+"            parameters of both -g and -d, except -B.\n\n" \
+"            Optional additional parameter for either -g or -d:\n" \
+"               -E              Events are in binary format (fixed-size little-endian records, see\n" \
+"                                events.h) rather than text.  The records also hold the strengths of\n" \
+"                                the row and column frequencies.  Not permitted with -B.\n" \
+"               -P PROFILE      Tones and thresholds to use in place of DTMF: \"dtmf\" (the default),\n" \
+"                                \"mfr1\" for MF R1 signalling, or the name of a profile file giving\n" \
+"                                the table of tones and symbols and the detection thresholds (twist,\n" \
+"                                separation, minimum level and duration; see tones.h).\n\n" \
+"            Optional additional parameters for -g (not permitted with -d):\n" \
+"               -t MSEC         Time duration (in milliseconds, default 1000) of the audio output.\n" \
+"               -n NOISE_FILE   specifies the name of an audio file containing \"noise\" to be combined\n" \
+"                               with the synthesized DTMF tones.\n" \
+"               -l LEVEL        specifies the loudness ratio (in dB, positive or negative) of the\n" \
+"                               noise to that of the DTMF tones.  A LEVEL of 0 (the default) means the\n" \
+"                               same level, negative values mean that the DTMF tones are louder than\n" \
+"                               the noise, positive values mean that the noise is louder than the\n" \
+"                               DTMF tones.\n\n" \
+"            Optional additional parameters for -d (not permitted with -g):\n" \
+"               -b BLOCKSIZE    specifies the number of samples (range [10, 1000], default 100)\n" \
+"                                in each block of audio to be analyzed for the presence of DTMF tones.\n" \
+"                                Audio at any sample rate, with any number of channels, can be\n" \
+"                                analyzed.  BLOCKSIZE counts samples at 8000 per second and is\n" \
+"                                scaled to the rate of the audio (e.g. 100 means 200 samples at\n" \
+"                                16000), so a block always covers the same time; a rate that\n" \
+"                                leaves fewer than 10 samples per block is an error.  HOP below\n" \
+"                                is scaled in the same way.  With more than one channel, each\n" \
+"                                channel is analyzed on its own, and each output line starts with\n" \
+"                                the channel number and a tab.\n" \
+"               -s HOP          analyze overlapping blocks, starting a new block every HOP samples\n" \
+"                                (range [1, BLOCKSIZE], e.g. BLOCKSIZE/4) for more precise event\n" \
+"                                boundaries.  By default blocks do not overlap (HOP = BLOCKSIZE).\n" \
+"               -j THREADS      analyze blocks using THREADS threads (range [1, 64], default 1).\n" \
+"                                The output is the same as with one thread.  Not used with -s.\n" \
+"               -B LIST         Batch: instead of standard input, detect DTMF events in each of the\n" \
+"                                audio files named in LIST, which is either a file containing one\n" \
+"                                pathname per line (\"-\" for standard input) or a directory, in\n" \
+"                                which case all the .au files in it are used.  Each output line is\n" \
+"                                prefixed with the pathname and a tab.  With -j, THREADS files are\n" \
+"                                processed at a time.  Not permitted with -s.\n" \
+"               -T FILE         Telemetry: write the strengths and the decision for every block to\n" \
+"                                FILE, one line per block, followed by a count of each decision\n" \
+"                                and histograms of the total strength and the twist (in dB), for\n" \
+"                                tuning.  Not permitted with -j or -B.\n" \
+"               -C FACTOR       Coarse then fine: analyze non-overlapping blocks, then analyze again\n" \
+"                                only the blocks around the start or end of a tone, in steps of\n" \
+"                                BLOCKSIZE / FACTOR samples (FACTOR in [2, 64], at most BLOCKSIZE)\n" \
+"                                each centered in a window of BLOCKSIZE.  Event boundaries come\n" \
+"                                out about as precise as with -s BLOCKSIZE/FACTOR, at close to the\n" \
+"                                cost of non-overlapping blocks.  Only used for a monaural file\n" \
+"                                (not a pipe).  Not permitted with -s, -j, -B, -T, -r or -D.\n" \
+"               -r              Real-time: for unbounded input such as a live call.  Each event is\n" \
+"                                written out in two tab-separated lines, each as soon as it is\n" \
+"                                known:\n" \
+"                                  START open SYMBOL LATENCY   once the tone has lasted the\n" \
+"                                                              minimum duration, then\n" \
+"                                  START END SYMBOL LATENCY    once it has ended,\n" \
+"                                where LATENCY is the number of samples read past the part of the\n" \
+"                                event decided so far.  With -E, the first is a record whose end\n" \
+"                                is -1.  Not permitted with -j or -B.\n" \
+"               -D              Decimate: low-pass filter audio sampled at 16000 or more and keep\n" \
+"                                only every M'th sample before analyzing it, where M is the largest\n" \
+"                                divisor of both the scaled BLOCKSIZE and the rate that leaves at\n" \
+"                                least 8000 samples per second.  Analysis is about M times cheaper;\n" \
+"                                event boundaries may come out a few samples later.  Not permitted\n" \
+"                                with -s.\n" \
+"               -F              Fixed point: run the Goertzel filters in integer arithmetic rather\n" \
+"                                than double precision.  Tone decisions are the same.  Not\n" \
+"                                permitted with -s.\n" \
+); \
+exit(retcode); \
+} while(0)
+
+#define LOOPBACK_OPTION (0x8)
+
+extern int hop_size;        // Distance between the starts of overlapping blocks, or 0 if they do not overlap.
+extern int num_threads;     // Number of threads used to analyze blocks in DTMF tone detection.
+extern char *batch_list;    // Manifest file or directory of audio files for batch detection, or NULL if none.
+extern char *telemetry_file; // File to which detection telemetry is to be written, or NULL if none.
+extern int realtime;        // Nonzero if events are to be written out as soon as they are detected.
+extern int decimate;        // Nonzero if high-rate audio is to be decimated before analysis.
+extern int fixed_point;     // Nonzero if the Goertzel filters are to be run in fixed-point arithmetic.
+extern int binary_events;   // Nonzero if DTMF events are read or written in binary format.
+extern int coarse_factor;   // Number of fine steps per block in two-pass detection, or 0 if not used.
+
+/*
+ * Batch counterpart of dtmf_detect, used with -B: detect the DTMF events in each of the
+ * audio files named in list (a manifest file or a directory) and write them to events_out,
+ * each line prefixed with the pathname of its file.
+ *
+ *   @return 0 if every file was analyzed successfully, EOF otherwise.
+ */
+int dtmf_detect_batch(char *list, FILE *events_out);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "detect.h"
+
+/*
+ * Detection telemetry, for tuning the block size and thresholds against real audio.
+ *
+ * When enabled, every decision made during detection is written as one tab-separated
+ * line to a side-channel file, separate from the events:
+ *
+ *     channel  start  end  s0 ... sN  sum_db  twist_db  verdict
+ *
+ * where start and end are the frames covered by the block (or window), s0 ... sN are
+ * the strengths of the frequencies of the tone profile, sum_db is the strength of the strongest
+ * row and column together and twist_db the ratio of the strongest row to the strongest
+ * column (both in dB), and verdict is the symbol found or the reason check_tone gave
+ * for rejecting the block ("weak", "twist", "row", "column" or "none").
+ *
+ * When detection is done, summary histograms of sum_db (over all blocks) and twist_db
+ * (over blocks strong enough for the twist to be checked) and a count of each verdict
+ * are appended, on lines starting with '#' so they are easily told from the blocks.
+ *
+ * When telemetry is off, the only cost is a test of telemetry_file once per decision.
+ */
+
+#define TELEMETRY_SUM_MIN_DB (-60)
+#define TELEMETRY_SUM_BIN_DB 2
+#define TELEMETRY_SUM_BINS 33
+#define TELEMETRY_TWIST_MIN_DB (-10)
+#define TELEMETRY_TWIST_BINS 21
+
+/**
+ * Open the telemetry file and start counting from scratch.
+ *
+ *   @param path  Pathname of the file to which telemetry is to be written.
+ *   @return 0 if successful, EOF otherwise.
+ */
+int telemetry_open(const char *path);
+
+/**
+ * Record one decision.
+ *
+ *   @param channel  Channel on which the decision was made.
+ *   @param start  Index of the first frame covered by the block.
+ *   @param end  Index of the frame following the block.
+ *   @param strengths  The strengths of the frequencies of the tone profile for the block.
+ *   @param dp  The decision made for the block.
+ */
+void telemetry_block(int channel, int64_t start, int64_t end, const double *strengths,
+    const DTMF_DECISION *dp);
+
+/**
+ * Write out the summary histograms and close the telemetry file.
+ *
+ *   @return 0 if successful, EOF otherwise.
+ */
+int telemetry_close(void);
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef TONES_H
+#define TONES_H
+
+#include <stdint.h>
+
+/*
+ * Tone profiles: the table of tones that make up the symbols to be generated or detected,
+ * together with the thresholds used to decide whether a block contains one of them.
+ *
+ * Every symbol is made up of two tones, sounded together.  In a grid table (such as DTMF)
+ * the frequencies are split into rows and columns, and each symbol is one row tone and one
+ * column tone.  In a pair table (such as MF R1) each symbol is any two of the frequencies.
+ * Either way, symbols[a][b] (with a < b, indices into freqs) is the symbol made up of
+ * frequencies a and b, or '\0' if there is none.
+ *
+ * A block holds a symbol if the strongest tone of each group (for a pair table, the two
+ * strongest tones) are together at least min_strength, are within a ratio of twist of each
+ * other, and are each at least a ratio of separation stronger than every other tone of
+ * their group.  Events shorter than min_duration seconds are discarded.
+ *
+ * The built-in profiles are "dtmf" (the default) and "mfr1".  Other profiles can be read
+ * from a text file containing one setting per line ('#' starts a comment):
+ *
+ *     rows F1 F2 ...            frequencies (in Hz) of the rows of a grid table
+ *     columns F1 F2 ...         frequencies of the columns of a grid table
+ *     symbols S1 S2 ...         one word per row of a grid table, one character per column
+ *     tones F1 F2 ...           frequencies of a pair table
+ *     pair F1 F2 C              symbol C of a pair table is made up of frequencies F1 and F2
+ *     twist DB                  ratio twist, in dB
+ *     separation DB             ratio separation, in dB
+ *     min_level DB              min_strength, in dB
+ *     min_duration MSEC         min_duration, in milliseconds
+ *
+ * Settings that are not given keep their DTMF values.  Frequencies must be whole numbers
+ * of Hz below half of AUDIO_FRAME_RATE, so that every profile can also be generated.
+ */
+
+#define MAX_TONE_FREQS 16
+
+typedef struct tone_profile {
+    int num_freqs;                                  // Number of frequencies in the table.
+    int num_rows;                                   // Number of row frequencies, or 0 for a pair table.
+    int freqs[MAX_TONE_FREQS];                      // Frequencies, in Hz: the rows first, then the columns.
+    char symbols[MAX_TONE_FREQS][MAX_TONE_FREQS];   // Symbol made up of frequencies a and b (a < b).
+    double twist;                                   // Largest ratio between the two tones of a symbol.
+    double separation;                              // Smallest ratio of a tone to the others in its group.
+    double min_strength;                            // Smallest total strength of the two tones.
+    double min_duration;                            // Shortest event, in seconds.
+} TONE_PROFILE;
+
+/*
+ * The profile in use, which is DTMF unless another one is loaded.
+ */
+extern TONE_PROFILE tone_profile;
+
+/**
+ * Load a profile, either one of the built-in profiles by name or a profile file.
+ *
+ *   @param name  Name of a built-in profile, or pathname of a profile file.
+ *   @param tp  The profile to be loaded.
+ *   @return 0 if successful, -1 if there is no such profile or the file is not valid.
+ */
+int tone_profile_load(const char *name, TONE_PROFILE *tp);
+
+/**
+ * Get the highest frequency in a profile.
+ *
+ *   @param tp  The profile.
+ *   @return  The highest frequency, in Hz.
+ */
+int tone_profile_max_freq(const TONE_PROFILE *tp);
+
+/**
+ * Get the symbol of a profile made up of two of its frequencies, in either order.
+ *
+ *   @param tp  The profile.
+ *   @param a  Index of one of the frequencies.
+ *   @param b  Index of the other frequency.
+ *   @return  The symbol, or '\0' if there is none.
+ */
+static inline char tone_symbol(const TONE_PROFILE *tp, int a, int b) {
+    return a < b ? *(*(tp -> symbols + a) + b) : *(*(tp -> symbols + b) + a);
+}
+
+#endif
@@ -1,6 +1,10 @@
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "audio.h"
+#include "audio_io.h"
 #include "debug.h"
 
 int read_bytes(FILE *in, int *result) {     // result = pointer
@@ -27,8 +31,23 @@ int read_bytes(FILE *in, int *result) {     // result = pointer
     return 0;
 }
 
-int audio_read_header(FILE *in, AUDIO_HEADER *hp) {
-    // TO BE IMPLEMENTED
+//helper function to check the fields of a decoded header
+//only AUDIO_FRAME_RATE and AUDIO_CHANNELS are valid unless any is set, in which case anything within the limits is
+int check_header(AUDIO_HEADER *hp, int any) {
+    //data offset is compared as a signed value, so huge offsets are rejected
+    if(hp -> magic_number != AUDIO_MAGIC || hp -> encoding != PCM16_ENCODING
+        || (int) hp -> data_offset < AUDIO_DATA_OFFSET)
+        return EOF;
+    if(!any)
+        return hp -> sample_rate == AUDIO_FRAME_RATE && hp -> channels == AUDIO_CHANNELS ? 0 : EOF;
+    if(hp -> sample_rate >= MIN_AUDIO_FRAME_RATE && hp -> sample_rate <= MAX_AUDIO_FRAME_RATE
+        && hp -> channels >= 1 && hp -> channels <= MAX_AUDIO_CHANNELS)
+        return 0;
+    return EOF;
+}
+
+//helper function to read a header for audio_read_header (any not set) or audio_read_header_any (any set)
+int read_header(FILE *in, AUDIO_HEADER *hp, int any) {
     //get magic number
     int m_number;
     if(read_bytes(in, &m_number) < 0) {
@@ -67,8 +86,7 @@ int audio_read_header(FILE *in, AUDIO_HEADER *hp) {
     }
     hp -> channels = chan;
     //check if the header is valid
-    if(m_number == AUDIO_MAGIC && encode == PCM16_ENCODING && s_rate == AUDIO_FRAME_RATE && chan == AUDIO_CHANNELS
-        && d_offset >= 24) {
+    if(check_header(hp, any) == 0) {
         //move pointer to start of data (offset - header = annotation)
         //current pointer is at end of header, now move to after annotations end (which is start of data)
         int annotations = d_offset - 24;
@@ -79,6 +97,86 @@ int audio_read_header(FILE *in, AUDIO_HEADER *hp) {
     } else return EOF;
 }
 
+int audio_read_header(FILE *in, AUDIO_HEADER *hp) {
+    // TO BE IMPLEMENTED
+    return read_header(in, hp, 0);
+}
+
+int audio_read_header_any(FILE *in, AUDIO_HEADER *hp) {
+    return read_header(in, hp, 1);
+}
+
+//helper function to decode one big-endian header field from memory
+uint32_t decode_bytes(const unsigned char *data) {
+    uint32_t ret_val = 0;
+    for(int i = 0; i < 4; i++) {
+        ret_val = (ret_val << 8) | *(data + i);
+    }
+    return ret_val;
+}
+
+//helper function to decode a header for audio_parse_header or audio_parse_header_any, as read_header does
+int parse_header(const unsigned char *data, size_t len, AUDIO_HEADER *hp, int any) {
+    if(len < AUDIO_DATA_OFFSET)
+        return EOF;
+    //same fields as audio_read_header; the data size is skipped there too
+    hp -> magic_number = decode_bytes(data);
+    hp -> data_offset = decode_bytes(data + 4);
+    hp -> encoding = decode_bytes(data + 12);
+    hp -> sample_rate = decode_bytes(data + 16);
+    hp -> channels = decode_bytes(data + 20);
+    return check_header(hp, any);
+}
+
+int audio_parse_header(const unsigned char *data, size_t len, AUDIO_HEADER *hp) {
+    return parse_header(data, len, hp, 0);
+}
+
+int audio_parse_header_any(const unsigned char *data, size_t len, AUDIO_HEADER *hp) {
+    return parse_header(data, len, hp, 1);
+}
+
+int audio_map_file(FILE *in, AUDIO_HEADER *hp, AUDIO_MAP *mp) {
+    //only regular files that nobody has started reading can be mapped
+    struct stat st;
+    int fd = fileno(in);
+    if(fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        return 1;
+    if(ftell(in) != 0)
+        return 1;
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(base == MAP_FAILED)
+        return 1;
+    //samples are walked front to back, so let the kernel read ahead aggressively
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+    mp -> base = base;
+    mp -> length = st.st_size;
+    if(audio_parse_header_any(mp -> base, mp -> length, hp) != 0) {
+        audio_unmap_file(mp);
+        return EOF;
+    }
+    //samples must be 2-byte aligned to be walked in place; odd offsets use the stream path
+    size_t offset = hp -> data_offset;
+    if(offset % AUDIO_BYTES_PER_SAMPLE != 0) {
+        audio_unmap_file(mp);
+        return 1;
+    }
+    //annotation data (if any) is skipped just by starting at the data offset
+    if(offset > mp -> length)
+        offset = mp -> length;
+    mp -> samples = (int16_t *) (mp -> base + offset);
+    mp -> num_samples = (mp -> length - offset) / AUDIO_BYTES_PER_SAMPLE;
+    return 0;
+}
+
+void audio_unmap_file(AUDIO_MAP *mp) {
+    munmap(mp -> base, mp -> length);
+    mp -> base = NULL;
+    mp -> length = 0;
+    mp -> samples = NULL;
+    mp -> num_samples = 0;
+}
+
 int write_bytes(FILE *out, int field) {
     int current;
     int number = field;
@@ -142,3 +240,58 @@ int audio_write_sample(FILE *out, int16_t sample) {
     //debug("%d", sample);
     return 0;
 }
+
+//helper function to swap the bytes of each sample between big-endian and host order
+void swap_samples(int16_t *samples, int count) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint16_t *p = (uint16_t *) samples;
+    for(int i = 0; i < count; i++) {
+        *(p + i) = __builtin_bswap16(*(p + i));
+    }
+#endif
+}
+
+int audio_read_samples(FILE *in, int16_t *samples, int count) {
+    //read the whole block at once, then fix up the byte order
+    size_t n = fread(samples, AUDIO_BYTES_PER_SAMPLE, count, in);
+    if(n < (size_t) count && ferror(in))
+        return EOF;
+    swap_samples(samples, n);
+    return n;
+}
+
+int audio_write_samples(FILE *out, int16_t *samples, int count) {
+    //convert to big-endian in place, write, then put the buffer back the way it was
+    swap_samples(samples, count);
+    size_t n = fwrite(samples, AUDIO_BYTES_PER_SAMPLE, count, out);
+    swap_samples(samples, count);
+    if(n != (size_t) count)
+        return EOF;
+    return 0;
+}
+
+//a block of zero bytes, for writing silence in bulk
+#define SILENCE_BUF_SIZE 65536
+static const char silence_buf[SILENCE_BUF_SIZE];
+
+int audio_write_silence(FILE *out, uint32_t count) {
+    off_t bytes = (off_t) count * AUDIO_BYTES_PER_SAMPLE;
+    //everything already written has to reach the file before its end can be compared with our position
+    if(fflush(out) != 0)
+        return EOF;
+    struct stat st;
+    int fd = fileno(out);
+    off_t pos = ftello(out);
+    if(fd >= 0 && pos >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && pos >= st.st_size) {
+        if(ftruncate(fd, pos + bytes) == 0 && fseeko(out, bytes, SEEK_CUR) == 0)
+            return 0;
+        return EOF;
+    }
+    while(bytes > 0) {
+        size_t n = bytes < SILENCE_BUF_SIZE ? bytes : SILENCE_BUF_SIZE;
+        if(fwrite(silence_buf, 1, n, out) != n)
+            return EOF;
+        bytes -= n;
+    }
+    return 0;
+}
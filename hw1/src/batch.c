@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "const.h"
+#include "audio.h"
+#include "detect.h"
+#include "options.h"
+#include "buffers.h"
+#include "debug.h"
+
+/*
+ * Batch DTMF detection: detection is run on each of a list of audio files, using a pool of
+ * num_threads worker threads that each take the next file from the list as soon as they are
+ * done with the previous one.  The list is either a manifest file (one pathname per line,
+ * "-" for standard input) or a directory, in which case every file in it whose name ends in
+ * ".au" is used.  The list is read as it is consumed, so it can be arbitrarily long.
+ *
+ * Each worker writes the events for a file into memory, and then writes all of them out at
+ * once with the pathname of the file in front of each line, so the lines for different files
+ * never get mixed up.  Files are written out in the order in which they are finished.
+ *
+ * Each worker also has a sample buffer of DETECT_BUF_SIZE samples, which plays the part of
+ * detect_buf for the files it works on.  These are allocated for the number of workers
+ * actually started, so nothing is set aside for them unless -B is used.
+ */
+
+//the source of pathnames, shared by all the workers
+static FILE *list_file;
+static DIR *list_dir;
+static char *list_dir_name;
+static pthread_mutex_t list_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//the output stream, shared by all the workers
+static FILE *batch_out;
+static pthread_mutex_t out_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//set if detection fails for any file
+static int batch_failed;
+
+//the sample buffers of the workers, one after another
+static int16_t *batch_bufs;
+
+//helper function to check whether a file name ends in ".au"
+static int is_audio_name(const char *name) {
+    const char *end = name;
+    while(*end != '\0')
+        end++;
+    return end - name > 3 && *(end - 3) == '.' && *(end - 2) == 'a' && *(end - 1) == 'u';
+}
+
+//helper function to get the next pathname from the list; returns NULL when there are no more
+//the pathname is allocated with malloc and must be freed by the caller
+static char *next_path(void) {
+    char *path = NULL;
+    pthread_mutex_lock(&list_mutex);
+    if(list_dir != NULL) {
+        struct dirent *de;
+        while((de = readdir(list_dir)) != NULL) {
+            if(is_audio_name(de -> d_name)) {
+                if(asprintf(&path, "%s/%s", list_dir_name, de -> d_name) < 0)
+                    path = NULL;
+                break;
+            }
+        }
+    } else {
+        size_t cap = 0;
+        ssize_t len;
+        //blank lines are skipped; the newline is not part of the name
+        while((len = getline(&path, &cap, list_file)) >= 0) {
+            if(len > 0 && *(path + len - 1) == '\n')
+                *(path + --len) = '\0';
+            if(len > 0)
+                break;
+        }
+        if(len < 0) {
+            free(path);
+            path = NULL;
+        }
+    }
+    pthread_mutex_unlock(&list_mutex);
+    return path;
+}
+
+//helper function to run detection on one file, with the events written to out
+static int detect_file(DETECT_WORKER *wp, int16_t *buf, const char *path, FILE *out) {
+    FILE *in = fopen(path, "r");
+    if(in == NULL)
+        return EOF;
+    AUDIO_HEADER header;
+    AUDIO_MAP map;
+    AUDIO_MAP *mapp;
+    int ret = open_audio(in, &header, &map, &mapp);
+    if(ret == 0)
+        ret = check_rate(header.sample_rate);
+    if(ret == 0)
+        ret = detect_blocks(in, &header, mapp, out, wp -> channels, buf);
+    if(mapp != NULL)
+        audio_unmap_file(mapp);
+    fclose(in);
+    return ret;
+}
+
+//helper function to write out the events for one file, with the pathname in front of each line
+//the lines are put together before the output is locked, so they go out in a single write
+static int write_events(const char *path, const char *events, size_t size) {
+    //a file without events writes nothing
+    if(size == 0)
+        return 0;
+    const char *end = events + size;
+    size_t path_len = strlen(path);
+    size_t lines = 0;
+    for(const char *p = events; p < end; lines++) {
+        const char *nl = memchr(p, '\n', end - p);
+        p = nl != NULL ? nl + 1 : end;
+    }
+    char *text = malloc(size + lines * (path_len + 1));
+    if(text == NULL)
+        return EOF;
+    char *t = text;
+    for(const char *p = events; p < end; ) {
+        const char *nl = memchr(p, '\n', end - p);
+        size_t len = nl != NULL ? (size_t) (nl + 1 - p) : (size_t) (end - p);
+        memcpy(t, path, path_len);
+        t += path_len;
+        *t++ = '\t';
+        memcpy(t, p, len);
+        t += len;
+        p += len;
+    }
+    size_t length = t - text;
+    pthread_mutex_lock(&out_mutex);
+    size_t written = fwrite(text, 1, length, batch_out);
+    pthread_mutex_unlock(&out_mutex);
+    free(text);
+    return written == length ? 0 : EOF;
+}
+
+//main function of each worker thread
+static void *batch_worker_main(void *arg) {
+    DETECT_WORKER *wp = arg;
+    int16_t *buf = batch_bufs + (size_t) wp -> index * DETECT_BUF_SIZE;
+    char *path;
+    while((path = next_path()) != NULL) {
+        char *events = NULL;
+        size_t size = 0;
+        FILE *out = open_memstream(&events, &size);
+        int ret = out == NULL ? EOF : detect_file(wp, buf, path, out);
+        if(out != NULL)
+            fclose(out);
+        if(ret != 0 || write_events(path, events, size) != 0) {
+            pthread_mutex_lock(&out_mutex);
+            fprintf(stderr, "%s: unable to %s DTMF events\n", path, ret != 0 ? "detect" : "write");
+            batch_failed = 1;
+            pthread_mutex_unlock(&out_mutex);
+        }
+        free(events);
+        free(path);
+    }
+    return NULL;
+}
+
+int dtmf_detect_batch(char *list, FILE *events_out) {
+    //the list is a directory of .au files or a manifest of pathnames
+    struct stat st;
+    list_file = NULL;
+    list_dir = NULL;
+    if(*list == '-' && *(list + 1) == '\0') {
+        list_file = stdin;
+    } else if(stat(list, &st) == 0 && S_ISDIR(st.st_mode)) {
+        list_dir = opendir(list);
+        list_dir_name = list;
+        if(list_dir == NULL)
+            return EOF;
+    } else {
+        list_file = fopen(list, "r");
+        if(list_file == NULL)
+            return EOF;
+    }
+    int threads = num_threads < MAX_DETECT_THREADS ? num_threads : MAX_DETECT_THREADS;
+    batch_bufs = malloc((size_t) threads * DETECT_BUF_SIZE * sizeof(int16_t));
+    if(batch_bufs == NULL) {
+        if(list_dir != NULL)
+            closedir(list_dir);
+        else if(list_file != stdin)
+            fclose(list_file);
+        return EOF;
+    }
+    batch_out = events_out;
+    batch_failed = 0;
+    get_detect_options(&detect_options);
+    //the workers' filters are left to setup_filters, which copies the coefficients in from the
+    //shared cache the first time (and whenever a file comes along at some other rate) and
+    //otherwise only resets them
+    int workers = 0;
+    for(int i = 0; i < threads; i++) {
+        DETECT_WORKER *wp = detect_workers + i;
+        wp -> index = i;
+        if(pthread_create(&wp -> thread, NULL, batch_worker_main, wp) != 0)
+            break;
+        workers++;
+    }
+    if(workers == 0)
+        batch_failed = 1;
+    for(int i = 0; i < workers; i++) {
+        pthread_join((detect_workers + i) -> thread, NULL);
+    }
+    free(batch_bufs);
+    batch_bufs = NULL;
+    if(list_dir != NULL)
+        closedir(list_dir);
+    else if(list_file != stdin)
+        fclose(list_file);
+    return batch_failed ? EOF : 0;
+}
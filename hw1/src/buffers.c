@@ -0,0 +1,21 @@
+#include <stdint.h>
+
+#include "buffers.h"
+
+/*
+ * Definitions of the buffers declared in buffers.h; see there for what each is for.
+ */
+
+char event_text_buf[EVENT_TEXT_BUF_SIZE];
+EVENT_RECORD event_buf[EVENT_BUF_SIZE];
+int16_t sample_buf[SAMPLE_BUF_SIZE];
+int16_t detect_buf[DETECT_BUF_SIZE];
+DETECT_CHANNEL detect_channels[MAX_AUDIO_CHANNELS];
+double cos_table[AUDIO_FRAME_RATE];
+double tone_buf[SAMPLE_BUF_SIZE];
+int16_t noise_buf[SAMPLE_BUF_SIZE];
+SLIDING_GOERTZEL_STATE sliding_state[MAX_AUDIO_CHANNELS][MAX_TONE_FREQS];
+int16_t window_buf[MAX_AUDIO_CHANNELS][MAX_BLOCK_FRAMES];
+DETECT_WORKER detect_workers[MAX_DETECT_THREADS];
+int16_t round_buf[DETECT_ROUND_SAMPLES];
+DTMF_DECISION decision_buf[DETECT_ROUND_BLOCKS];
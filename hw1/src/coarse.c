@@ -0,0 +1,129 @@
+#include <stdio.h>
+
+#include "const.h"
+#include "audio.h"
+#include "detect.h"
+#include "options.h"
+#include "buffers.h"
+#include "goertzel.h"
+#include "goertzel_bank.h"
+#include "debug.h"
+
+/*
+ * Two-pass (coarse, then fine) DTMF detection.
+ * The audio is first scanned in non-overlapping blocks of block_size frames, just as by
+ * detect_blocks, and each block is classed as holding one symbol throughout, as holding
+ * none throughout (quiet or noise), or as mixed (anything else, which is what a block
+ * straddling the edge of a tone looks like).  A block is only classed as holding the same
+ * thing throughout if its energy is also spread evenly over its quarters, as the filters
+ * over the whole block cannot see a short gap between two presses of the same key;
+ * measuring the energy is a small fraction of the cost of running the filter bank.
+ *
+ * Wherever a block is mixed or differs from one of its neighbours, there is a boundary
+ * nearby, and that block is analyzed again in coarse_factor steps: each step is decided by a
+ * window of block_size frames centered on it, as by detect_sliding with a hop of
+ * block_size / coarse_factor.  Every other block simply keeps its own decision.  So event
+ * boundaries come out about as precise as with overlapping blocks, while the filters are
+ * only run once over most of the audio.
+ *
+ * Windows around boundaries are taken out of order, so this needs the input mapped into
+ * memory; with a stream (or more than one channel), plain detection is done instead.
+ */
+
+//class of a block that holds no symbol throughout
+#define COARSE_NONE 0
+//class of a block that does not hold the same thing throughout
+#define COARSE_MIXED (-1)
+
+//decision and class of a block; the class is the symbol found, COARSE_NONE or COARSE_MIXED
+typedef struct coarse_block {
+    DTMF_DECISION decision;
+    int class;
+} COARSE_BLOCK;
+
+//helper function to analyze the N frames starting at frame s of T, which may run off either
+//end of the audio; the part that does is taken as silence
+static void decide_window(AUDIO_MAP *map, int64_t s, int N, int64_t T, uint32_t rate, DETECT_CHANNEL *chp,
+    DTMF_DECISION *dp) {
+    if(s >= 0 && s + N <= T) {
+        decide_block(map -> samples + s, N, rate, 1, chp -> states, chp -> strengths, &detect_options, dp);
+        return;
+    }
+    for(int i = 0; i < N; i++) {
+        *(detect_buf + i) = s + i >= 0 && s + i < T ? block_sample(map -> samples + (s + i), 0, 1) : 0;
+    }
+    decide_block(detect_buf, N, rate, 0, chp -> states, chp -> strengths, &detect_options, dp);
+}
+
+//helper function to tell whether the energy of each quarter of a block is within a quarter of its share
+static int even_energy(const int16_t *block, int N) {
+    uint64_t quarters[4], energy = 0;
+    for(int i = 0; i < 4; i++) {
+        *(quarters + i) = goertzel_block_energy(block + i * N / 4, (i + 1) * N / 4 - i * N / 4, 1);
+        energy += *(quarters + i);
+    }
+    if(energy == 0)
+        return 1;
+    for(int i = 0; i < 4; i++) {
+        double share = 4 * (double) *(quarters + i) / energy;
+        if(share < 0.75 || share > 1.25)
+            return 0;
+    }
+    return 1;
+}
+
+//helper function to analyze and class block j of N frames out of T
+static void decide_coarse(AUDIO_MAP *map, int64_t j, int N, int64_t T, uint32_t rate, DETECT_CHANNEL *chp,
+    COARSE_BLOCK *cp) {
+    int64_t first = j * N;
+    decide_window(map, first, N, T, rate, chp, &cp -> decision);
+    //past the end of the audio there is only silence; a quiet block (with no strengths) is the same throughout
+    if(first >= T || (cp -> decision.tone == TONE_WEAK && cp -> decision.sum == 0))
+        cp -> class = COARSE_NONE;
+    else if(first + N > T || !even_energy(map -> samples + first, N))
+        cp -> class = COARSE_MIXED;
+    else if(cp -> decision.tone == TONE_FOUND)
+        cp -> class = tone_symbol(detect_options.profile, cp -> decision.str_row_index, cp -> decision.str_col_index);
+    else
+        cp -> class = COARSE_NONE;
+}
+
+int detect_coarse(FILE *audio_in, AUDIO_HEADER *hp, AUDIO_MAP *map, FILE *events_out) {
+    if(map == NULL || hp -> channels != 1)
+        return detect_blocks(audio_in, hp, map, events_out, detect_channels, detect_buf);
+    int N = block_frames(block_size, hp -> sample_rate);
+    //below AUDIO_FRAME_RATE a block can have fewer frames than steps
+    int C = coarse_factor < N ? coarse_factor : N;
+    int64_t T = map -> num_samples;
+    uint32_t rate = hp -> sample_rate;
+    DETECT_CHANNEL *chp = detect_channels;
+    init_event(&chp -> event, -1, rate, &detect_options);
+    //the blocks before, at and after the current one
+    COARSE_BLOCK prev = { .class = COARSE_NONE }, cur, next;
+    decide_coarse(map, 0, N, T, rate, chp, &cur);
+    //as in detect_blocks, there are T / N full blocks and then a final short (maybe empty) one
+    int64_t blocks = T / N;
+    for(int64_t j = 0; j <= blocks; j++) {
+        decide_coarse(map, j + 1, N, T, rate, chp, &next);
+        if(cur.class != COARSE_MIXED && cur.class == prev.class && cur.class == next.class) {
+            chp -> event.position = j * N + N < T ? j * N + N : T;
+            if(update_event(&chp -> event, &cur.decision, N, events_out) != 0)
+                return EOF;
+        } else {
+            //step k covers frames [k * N / C, (k + 1) * N / C) of the block
+            for(int k = 0; k < C; k++) {
+                int64_t start = j * N + k * N / C;
+                int step = (k + 1) * N / C - k * N / C;
+                DTMF_DECISION d;
+                decide_window(map, start + step / 2 - N / 2, N, T, rate, chp, &d);
+                chp -> event.position = start + step < T ? start + step : T;
+                if(update_event(&chp -> event, &d, step, events_out) != 0)
+                    return EOF;
+            }
+        }
+        prev = cur;
+        cur = next;
+    }
+    finish_event(&chp -> event, T, events_out);
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <stdint.h>
+#include <math.h>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+#include "debug.h"
+#include "decimate.h"
+
+int decimate_factor(uint32_t rate, int N) {
+    for(int M = rate / 8000; M > 1; M--) {
+        if(N % M == 0 && rate % M == 0)
+            return M;
+    }
+    return 1;
+}
+
+void decimator_init(DECIMATOR *dp, uint32_t rate, int M) {
+    //frequencies that would alias onto the DTMF band after decimation start at
+    //rate/M - DECIMATE_PASS_EDGE, which leaves this much room for the filter to roll off
+    double transition = (double) rate / M - 2 * DECIMATE_PASS_EDGE;
+    //length of a Hamming-windowed filter with that transition band, made odd for a whole-sample delay
+    int L = (int) ceil(3.3 * rate / transition);
+    if(L % 2 == 0)
+        L++;
+    if(L > DECIMATE_MAX_TAPS)
+        L = DECIMATE_MAX_TAPS - 1;
+    dp -> M = M;
+    dp -> L = L;
+    //cutoff half way across the transition band, at the new Nyquist frequency (as a fraction of rate)
+    double fc = 0.5 / M;
+    double sum = 0;
+    for(int n = 0; n < L; n++) {
+        double t = n - (L - 1) / 2.0;
+        double sinc = t == 0 ? 2 * fc : sin(2 * M_PI * fc * t) / (M_PI * t);
+        double window = 0.54 - 0.46 * cos(2 * M_PI * n / (L - 1));
+        *(dp -> h + n) = sinc * window;
+        sum += *(dp -> h + n);
+    }
+    //unit gain at DC, so tones keep their strength
+    for(int n = 0; n < L; n++) {
+        *(dp -> h + n) /= sum;
+    }
+    for(int i = 0; i < L - 1; i++) {
+        *(dp -> x + i) = 0;
+    }
+}
+
+//scalar kernels: convert count samples to doubles at x, and compute count outputs,
+//output m from the L inputs starting at x + m * M
+static void load_scalar(double *x, const int16_t *samples, int count, int big_endian) {
+    for(int i = 0; i < count; i++) {
+        int16_t sample = *(samples + i);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if(big_endian)
+            sample = (int16_t) __builtin_bswap16(sample);
+#endif
+        *(x + i) = sample;
+    }
+}
+
+static void fir_run_scalar(const double *h, int L, const double *x, int M, double *y, int count) {
+    for(int m = 0; m < count; m++) {
+        const double *window = x + m * M;
+        double sum = 0;
+        for(int j = 0; j < L; j++) {
+            sum += *(h + j) * *(window + j);
+        }
+        *(y + m) = sum;
+    }
+}
+
+#ifdef __x86_64__
+//AVX2 kernels (the filter also uses fused multiply-adds, which every AVX2 CPU has)
+__attribute__((target("avx2")))
+static void load_avx2(double *x, const int16_t *samples, int count, int big_endian) {
+    //byte order of four samples is swapped by shuffling the bytes within each sample
+    __m128i swap = _mm_set_epi8(15, 14, 13, 12, 11, 10, 9, 8, 6, 7, 4, 5, 2, 3, 0, 1);
+    int i = 0;
+    for(; i + 4 <= count; i += 4) {
+        __m128i s16 = _mm_loadl_epi64((const __m128i *) (samples + i));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if(big_endian)
+            s16 = _mm_shuffle_epi8(s16, swap);
+#endif
+        _mm256_storeu_pd(x + i, _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(s16)));
+    }
+    _mm256_zeroupper();
+    load_scalar(x + i, samples + i, count - i, big_endian);
+}
+
+//helper function to add up the four lanes of a vector
+__attribute__((target("avx2")))
+static inline double lane_sum(__m256d v) {
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+}
+
+//four taps at a time, for four outputs at a time (so that the four sums,
+//which do not depend on each other, can be worked on at the same time)
+__attribute__((target("avx2,fma")))
+static void fir_run_avx2(const double *h, int L, const double *x, int M, double *y, int count) {
+    int L4 = L & ~3;
+    int m = 0;
+    for(; m + 4 <= count; m += 4) {
+        const double *w0 = x + m * M;
+        const double *w1 = w0 + M, *w2 = w1 + M, *w3 = w2 + M;
+        __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+        __m256d a2 = _mm256_setzero_pd(), a3 = _mm256_setzero_pd();
+        for(int j = 0; j < L4; j += 4) {
+            __m256d hj = _mm256_loadu_pd(h + j);
+            a0 = _mm256_fmadd_pd(hj, _mm256_loadu_pd(w0 + j), a0);
+            a1 = _mm256_fmadd_pd(hj, _mm256_loadu_pd(w1 + j), a1);
+            a2 = _mm256_fmadd_pd(hj, _mm256_loadu_pd(w2 + j), a2);
+            a3 = _mm256_fmadd_pd(hj, _mm256_loadu_pd(w3 + j), a3);
+        }
+        double s0 = lane_sum(a0), s1 = lane_sum(a1), s2 = lane_sum(a2), s3 = lane_sum(a3);
+        for(int j = L4; j < L; j++) {
+            s0 += *(h + j) * *(w0 + j);
+            s1 += *(h + j) * *(w1 + j);
+            s2 += *(h + j) * *(w2 + j);
+            s3 += *(h + j) * *(w3 + j);
+        }
+        *(y + m) = s0;
+        *(y + m + 1) = s1;
+        *(y + m + 2) = s2;
+        *(y + m + 3) = s3;
+    }
+    //avoid AVX/SSE transition stalls in the (non-VEX) caller
+    _mm256_zeroupper();
+    fir_run_scalar(h, L, x + m * M, M, y + m, count - m);
+}
+#endif
+
+void decimator_run(DECIMATOR *dp, const int16_t *samples, int count, int big_endian, int16_t *out) {
+    int L = dp -> L;
+    int M = dp -> M;
+    //append the new samples to the history, then filter; each output only needs
+    //the L samples up to and including the last input it stands for
+    double *y = dp -> y;
+#ifdef __x86_64__
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        load_avx2(dp -> x + L - 1, samples, count, big_endian);
+        fir_run_avx2(dp -> h, L, dp -> x + M - 1, M, y, count / M);
+    } else {
+        load_scalar(dp -> x + L - 1, samples, count, big_endian);
+        fir_run_scalar(dp -> h, L, dp -> x + M - 1, M, y, count / M);
+    }
+#else
+    load_scalar(dp -> x + L - 1, samples, count, big_endian);
+    fir_run_scalar(dp -> h, L, dp -> x + M - 1, M, y, count / M);
+#endif
+    for(int m = 0; m < count / M; m++) {
+        double v = round(*(y + m));
+        if(v > INT16_MAX)
+            v = INT16_MAX;
+        else if(v < INT16_MIN)
+            v = INT16_MIN;
+        *(out + m) = (int16_t) v;
+    }
+    //keep the last L-1 samples for the next block
+    for(int i = 0; i < L - 1; i++) {
+        *(dp -> x + i) = *(dp -> x + count + i);
+    }
+}
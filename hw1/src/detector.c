@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "const.h"
+#include "detector.h"
+#include "debug.h"
+
+//helper function to round a size in the storage of a detector up so that whatever follows it is aligned
+static size_t storage_align(size_t size) {
+    size_t align = _Alignof(max_align_t);
+    return (size + align - 1) / align * align;
+}
+
+int dtmf_detector_init(DTMF_DETECTOR *dp, uint32_t rate, int channels, int block_size,
+    const DETECT_OPTIONS *options, DETECTOR_CALLBACK callback, void *arg) {
+    if(channels < 1 || channels > MAX_AUDIO_CHANNELS || block_size < MIN_BLOCK_SIZE || block_size > DETECTOR_MAX_BLOCK
+        || options == NULL || options -> profile == NULL || callback == NULL
+        || 2 * (uint32_t) tone_profile_max_freq(options -> profile) >= rate)
+        return -1;
+    //one allocation holds the settings, the profile, the events, the filters and strengths of
+    //every channel, and the buffers, in that order
+    int F = options -> profile -> num_freqs;
+    size_t options_size = storage_align(sizeof(DETECT_OPTIONS));
+    size_t profile_size = storage_align(sizeof(TONE_PROFILE));
+    size_t events_size = storage_align(channels * sizeof(EVENT_STATE));
+    size_t states_size = storage_align((size_t) channels * F * sizeof(GOERTZEL_STATE));
+    size_t strengths_size = storage_align((size_t) channels * F * sizeof(double));
+    size_t block_buf_size = storage_align((size_t) channels * block_size * sizeof(int16_t));
+    //monaural blocks are analyzed where they are, so they need no channel buffer
+    size_t channel_buf_size = channels > 1 ? block_size * sizeof(int16_t) : 0;
+    //zero N makes setup_filters initialize the filters for the first block
+    char *storage = calloc(1, options_size + profile_size + events_size + states_size + strengths_size
+        + block_buf_size + channel_buf_size);
+    if(storage == NULL)
+        return -1;
+    TONE_PROFILE *profile = (TONE_PROFILE *) (storage + options_size);
+    *profile = *options -> profile;
+    dp -> options = (DETECT_OPTIONS *) storage;
+    dp -> options -> profile = profile;
+    dp -> options -> fixed_point = options -> fixed_point;
+    storage += options_size + profile_size;
+    dp -> events = (EVENT_STATE *) storage;
+    storage += events_size;
+    dp -> states = (GOERTZEL_STATE *) storage;
+    storage += states_size;
+    dp -> strengths = (double *) storage;
+    storage += strengths_size;
+    dp -> block_buf = (int16_t *) storage;
+    storage += block_buf_size;
+    dp -> channel_buf = channels > 1 ? (int16_t *) storage : NULL;
+    dp -> rate = rate;
+    dp -> channels = channels;
+    dp -> block_size = block_size;
+    dp -> frames = 0;
+    dp -> pending = 0;
+    dp -> finished = 0;
+    for(int c = 0; c < channels; c++) {
+        EVENT_STATE *ep = dp -> events + c;
+        init_event(ep, channels == 1 ? -1 : c, rate, dp -> options);
+        ep -> emit = callback;
+        ep -> emit_arg = arg;
+    }
+    return 0;
+}
+
+//helper function to analyze one block of interleaved frames on every channel, n of which are real
+//(the rest being padding at the end of the stream)
+static int analyze_block(DTMF_DETECTOR *dp, const int16_t *frames, int n) {
+    int N = dp -> block_size;
+    int C = dp -> channels;
+    int F = dp -> options -> profile -> num_freqs;
+    dp -> frames += n;
+    for(int c = 0; c < C; c++) {
+        EVENT_STATE *ep = dp -> events + c;
+        const int16_t *block = frames;
+        if(C > 1) {
+            for(int i = 0; i < N; i++) {
+                *(dp -> channel_buf + i) = *(frames + i * C + c);
+            }
+            block = dp -> channel_buf;
+        }
+        DTMF_DECISION d;
+        decide_block(block, N, dp -> rate, 0, dp -> states + c * F, dp -> strengths + c * F, dp -> options, &d);
+        ep -> position = dp -> frames;
+        if(update_event(ep, &d, N, NULL) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int dtmf_detector_push(DTMF_DETECTOR *dp, const int16_t *samples, size_t count) {
+    if(dp -> finished)
+        return -1;
+    int block_samples = dp -> block_size * dp -> channels;
+    while(count > 0) {
+        //whole blocks are analyzed straight out of the caller's buffer when nothing is pending
+        if(dp -> pending == 0 && count >= (size_t) block_samples) {
+            if(analyze_block(dp, samples, dp -> block_size) != 0)
+                return -1;
+            samples += block_samples;
+            count -= block_samples;
+            continue;
+        }
+        size_t n = block_samples - dp -> pending;
+        n = n < count ? n : count;
+        for(size_t i = 0; i < n; i++) {
+            *(dp -> block_buf + dp -> pending + i) = *(samples + i);
+        }
+        dp -> pending += n;
+        samples += n;
+        count -= n;
+        if(dp -> pending == block_samples) {
+            dp -> pending = 0;
+            if(analyze_block(dp, dp -> block_buf, dp -> block_size) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int dtmf_detector_finish(DTMF_DETECTOR *dp) {
+    if(dp -> finished)
+        return -1;
+    dp -> finished = 1;
+    //as in dtmf_detect, the final block is always analyzed, even if it is empty
+    int n = dp -> pending / dp -> channels;
+    for(int i = n * dp -> channels; i < dp -> block_size * dp -> channels; i++) {
+        *(dp -> block_buf + i) = 0;
+    }
+    dp -> pending = 0;
+    int ret = analyze_block(dp, dp -> block_buf, n);
+    for(int c = 0; c < dp -> channels; c++) {
+        finish_event(dp -> events + c, dp -> frames, NULL);
+    }
+    return ret;
+}
+
+void dtmf_detector_destroy(DTMF_DETECTOR *dp) {
+    free(dp -> options);
+    dp -> options = NULL;
+    dp -> events = NULL;
+    dp -> states = NULL;
+    dp -> strengths = NULL;
+    dp -> block_buf = NULL;
+    dp -> channel_buf = NULL;
+}
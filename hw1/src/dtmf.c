@@ -1,11 +1,21 @@
 #include <stdlib.h>
 #include <math.h>
+#include <inttypes.h>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
 
 #include "const.h"
 #include "audio.h"
 #include "dtmf.h"
 #include "dtmf_static.h"
 #include "goertzel.h"
+#include "goertzel_bank.h"
+#include "audio_io.h"
+#include "options.h"
+#include "buffers.h"
+#include "detect.h"
+#include "telemetry.h"
 #include "debug.h"
 
 #ifdef _STRING_H
@@ -33,6 +43,22 @@
  * IF YOU VIOLATE THIS RESTRICTION, YOU WILL GET A ZERO!/
  */
 
+/*
+ * Options beyond those of const.h, set by validargs; see options.h.
+ */
+int hop_size;
+int num_threads;
+char *batch_list;
+char *telemetry_file;
+int realtime;
+int decimate;
+int fixed_point;
+int binary_events;
+int coarse_factor;
+
+//the settings of the analysis, gathered from the options above by get_detect_options
+DETECT_OPTIONS detect_options;
+
 //string to number helper function -- accounts for negative numbers; returns 0 or 1 along with converted number
 int str_to_num(char *str_number, int *number) {
     int n = 0;
@@ -59,15 +85,14 @@ int str_comp(char *str1, char *str2) {
   return 0;
 }
 
-//function to look up given symbol in 2D mapping
+//function to look up given symbol in the tone table
 int find_symbol(char symbol, int *fr, int *fc) {
-    //mapping[i][j] = mapping[rows][columns]
-    for(int i = 0; i < NUM_DTMF_ROW_FREQS; i++) {
-        for(int j =  0; j < NUM_DTMF_COL_FREQS; j++) {
-            if(symbol == *(*(dtmf_symbol_names +i) +j)) {
-                //dtmf_freqs[fr], dtmf_freqs[fc + 4]
-                *fr = *(dtmf_freqs+i);
-                *fc = *(dtmf_freqs+(j+4));
+    //symbols[i][j] is the symbol made up of frequencies i and j (i < j); for a grid, i is a row and j a column
+    for(int i = 0; i < tone_profile.num_freqs; i++) {
+        for(int j = i + 1; j < tone_profile.num_freqs; j++) {
+            if(symbol == *(*(tone_profile.symbols + i) + j)) {
+                *fr = *(tone_profile.freqs + i);
+                *fc = *(tone_profile.freqs + j);
                 return 0;
             }
         }
@@ -75,31 +100,97 @@ int find_symbol(char symbol, int *fr, int *fc) {
     return -1;
 }
 
-//function to get start index, end index, symbol
-void get_event_fields(int *s_index, int *e_index, char *symbol) {
-    //REMINDER: *(line_buf + i) is the same as line_buf[i] and line_buf = addr
-    //process one line at a time (i.e., line_buf until end of file)
-    //get start index
-    char *buf_p = line_buf;
-    for(char *current_p = line_buf; *current_p != '\0'; current_p++) {
-        if(*current_p == '\t') {
-            *current_p = '\0';
-            str_to_num(buf_p, s_index);
-            buf_p = current_p + 1;
-            break;
-        }
+//position of the next character in event_text_buf, and the end of the text in it
+static char *text_pos = NULL;
+static char *text_end = NULL;
+
+//function to get the next character of the events text, reading another buffer full when needed
+//returns EOF at the end of the input
+static inline int next_char(FILE *events_in) {
+    if(text_pos == text_end) {
+        size_t n = fread(event_text_buf, 1, EVENT_TEXT_BUF_SIZE, events_in);
+        if(n == 0)
+            return EOF;
+        text_pos = event_text_buf;
+        text_end = event_text_buf + n;
     }
-    //get end index
-    for(char *current_p = buf_p; *current_p != '\0'; current_p++) {
-        if(*current_p == '\t') {
-            *current_p = '\0';
-            str_to_num(buf_p, e_index);
-            buf_p = current_p + 1;
-            break;
-        }
+    return (unsigned char) *text_pos++;
+}
+
+//function to parse a sample index starting with character *c, leaving the character after it in *c
+//returns 0, or -1 if there is no number or it does not fit in an int
+static int read_index(FILE *events_in, int *c, int *index) {
+    int negative = *c == '-';
+    if(negative)
+        *c = next_char(events_in);
+    if(*c < '0' || *c > '9')
+        return -1;
+    int64_t n = 0;
+    for(; *c >= '0' && *c <= '9'; *c = next_char(events_in)) {
+        n = n * 10 + (*c - '0');
+        if(n > INT32_MAX)
+            return -1;
     }
-    //get symbol and check that it is valid
-    *symbol = *buf_p;
+    *index = negative ? -n : n;
+    return 0;
+}
+
+//function to skip the blanks between fields; returns -1 if there are none
+static int skip_blanks(FILE *events_in, int *c) {
+    if(*c != '\t' && *c != ' ')
+        return -1;
+    while(*c == '\t' || *c == ' ')
+        *c = next_char(events_in);
+    return 0;
+}
+
+//function to get start index, end index, symbol from the next line of the events text
+//anything after the symbol is ignored, as are empty lines
+//returns 1 if an event was read, 0 at the end of the input, -1 if the line is not valid
+int read_text_event(FILE *events_in, int *s_index, int *e_index, char *symbol) {
+    int c = next_char(events_in);
+    while(c == '\n' || c == '\r')
+        c = next_char(events_in);
+    if(c == EOF)
+        return 0;
+    if(read_index(events_in, &c, s_index) != 0 || skip_blanks(events_in, &c) != 0
+        || read_index(events_in, &c, e_index) != 0 || skip_blanks(events_in, &c) != 0)
+        return -1;
+    if(c == '\n' || c == '\r' || c == EOF)
+        return -1;
+    *symbol = c;
+    while(c != '\n' && c != EOF)
+        c = next_char(events_in);
+    return 1;
+}
+
+//position of the next record in event_buf, and the number of records in it
+static int event_buf_pos = 0;
+static int event_buf_len = 0;
+
+//function to get the next DTMF event from the input, as a line of text or a binary record
+//returns 1 if an event was read, 0 at the end of the input, -1 if the input is not valid
+int next_event(FILE *events_in, int *s_index, int *e_index, char *symbol) {
+    if(!binary_events)
+        return read_text_event(events_in, s_index, e_index, symbol);
+    //records are read a buffer at a time
+    if(event_buf_pos == event_buf_len) {
+        int n = events_read_records(events_in, event_buf, EVENT_BUF_SIZE);
+        if(n == EOF)
+            return -1;
+        if(n == 0)
+            return 0;
+        event_buf_pos = 0;
+        event_buf_len = n;
+    }
+    EVENT_RECORD *rp = event_buf + event_buf_pos++;
+    //generated audio is monaural, and its length is an int
+    if(rp -> channel != -1 || rp -> start < 0 || rp -> end > INT32_MAX)
+        return -1;
+    *s_index = rp -> start;
+    *e_index = rp -> end;
+    *symbol = rp -> symbol;
+    return 1;
 }
 
 //function to check if a noise file has been given
@@ -119,53 +210,157 @@ int check_file(FILE *fp) {
     return 1;
 }
 
-//function to combine noise file with sample
-int combine_noise_file(FILE *fp, FILE *audio_out, double sample) {
-    //if header is successfully read (when check_file), get samples from file
-    int16_t noise_sample;
-    int read_sample = audio_read_sample(fp, &noise_sample);
-    if(read_sample == EOF) {
-        noise_sample = 0;
-    }
-    //if file sample is valid, combine with current sample
-    //w = (10^dB/10) / (1 + 10^dB/10)
-    double w = (pow(10,(noise_level/10.0)) / (1 + pow(10, noise_level/10.0)));
-    double final_sample = (double)(noise_sample * w) + (sample * (1-w));
-    //debug("w: %lf, val: %lf \n", w, (noise_sample * w) + (sample * (1-w)));
-    int write_sample = audio_write_sample(audio_out, (int16_t)final_sample);
-    if(write_sample != 0) {
-        //debug("combine noise file write sample failed");
+//number of samples currently waiting in sample_buf to be written out
+static int sample_buf_len = 0;
+
+//function to write out any samples waiting in the output buffer
+int flush_samples(FILE *audio_out) {
+    int write_samples = audio_write_samples(audio_out, sample_buf, sample_buf_len);
+    sample_buf_len = 0;
+    if(write_samples != 0)
         return -1;
-    }
     return 0;
 }
 
-int set_zero_padding(FILE *audio_out, FILE *fp, int file_bool, int start, int end) {
-    int16_t sample = 0;
-    for(int i = start; i < end; i++) {
+//weight of the noise in mixed samples: w = (10^dB/10) / (1 + 10^dB/10), set once per run
+static double noise_weight;
+
+//function to mix count synthesized samples with count noise samples, the noise weighted by w
+//the result is saturated to the range of a sample, then truncated
+static void mix_noise_scalar(int16_t *out, const double *tone, const int16_t *noise, int count, double w) {
+    for(int i = 0; i < count; i++) {
+        double x = (double)(*(noise + i) * w) + (*(tone + i) * (1-w));
+        if(x > INT16_MAX)
+            x = INT16_MAX;
+        else if(x < INT16_MIN)
+            x = INT16_MIN;
+        *(out + i) = (int16_t) x;
+    }
+}
+
+#ifdef __x86_64__
+//AVX2 version, four samples at a time, with the same operations in the same order
+__attribute__((target("avx2")))
+static void mix_noise_avx2(int16_t *out, const double *tone, const int16_t *noise, int count, double w) {
+    __m256d wn = _mm256_set1_pd(w);
+    __m256d wt = _mm256_set1_pd(1-w);
+    __m256d hi = _mm256_set1_pd(INT16_MAX);
+    __m256d lo = _mm256_set1_pd(INT16_MIN);
+    int i = 0;
+    for(; i + 4 <= count; i += 4) {
+        __m128i n16 = _mm_loadl_epi64((const __m128i *) (noise + i));
+        __m256d n = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(n16));
+        __m256d x = _mm256_add_pd(_mm256_mul_pd(n, wn), _mm256_mul_pd(_mm256_loadu_pd(tone + i), wt));
+        x = _mm256_max_pd(_mm256_min_pd(x, hi), lo);
+        __m128i x32 = _mm256_cvttpd_epi32(x);
+        _mm_storel_epi64((__m128i *) (out + i), _mm_packs_epi32(x32, x32));
+    }
+    //avoid AVX/SSE transition stalls in the (non-VEX) caller
+    _mm256_zeroupper();
+    mix_noise_scalar(out + i, tone + i, noise + i, count - i, w);
+}
+#endif
+
+//function to mix synthesized samples with noise samples, as fast as the CPU allows
+void mix_noise(int16_t *out, const double *tone, const int16_t *noise, int count, double w) {
+#ifdef __x86_64__
+    if(__builtin_cpu_supports("avx2")) {
+        mix_noise_avx2(out, tone, noise, count, w);
+        return;
+    }
+#endif
+    mix_noise_scalar(out, tone, noise, count, w);
+}
+
+//function to read count samples from the noise file; noise past the end of the file is silence
+void read_noise(FILE *fp, int16_t *noise, int count) {
+    int n = audio_read_samples(fp, noise, count);
+    if(n == EOF)
+        n = 0;
+    for(int i = n; i < count; i++) {
+        *(noise + i) = 0;
+    }
+}
+
+//function to fill cos_table, the first time it is needed
+void init_cos_table(void) {
+    static int cos_table_ready = 0;
+    if(cos_table_ready)
+        return;
+    for(int m = 0; m < AUDIO_FRAME_RATE; m++) {
+        *(cos_table + m) = cos(2.0 * M_PI * m / AUDIO_FRAME_RATE) * 0.5;
+    }
+    cos_table_ready = 1;
+}
+
+//function to synthesize count samples of the tone with frequencies fr and fc into tone
+//*pr and *pc are the positions of the two frequencies in cos_table, and are advanced past the samples
+void synth_tone(double *tone, int count, int fr, int fc, int *pr, int *pc) {
+    int r = *pr;
+    int c = *pc;
+    for(int i = 0; i < count; i++) {
+        *(tone + i) = (*(cos_table + r) + *(cos_table + c)) * INT16_MAX;
+        r += fr;
+        if(r >= AUDIO_FRAME_RATE)
+            r -= AUDIO_FRAME_RATE;
+        c += fc;
+        if(c >= AUDIO_FRAME_RATE)
+            c -= AUDIO_FRAME_RATE;
+    }
+    *pr = r;
+    *pc = c;
+}
+
+//function to write out count synthesized samples, combined with the noise file if one was given
+//the samples go straight into the output buffer, which is written out whenever it fills up
+int write_tone(FILE *audio_out, FILE *fp, int file_bool, double *tone, int count) {
+    while(count > 0) {
+        int n = SAMPLE_BUF_SIZE - sample_buf_len;
+        if(n > count)
+            n = count;
+        int16_t *out = sample_buf + sample_buf_len;
         if(file_bool != 0) {
-            //if so combine with zero sample
-            int combine = combine_noise_file(fp, audio_out, sample);
-            if(combine != 0) {
-                //debug("combine noise file zero padding write sample failed");
-                return -1;
-            }
+            read_noise(fp, noise_buf, n);
+            mix_noise(out, tone, noise_buf, n, noise_weight);
         } else {
-            //else just pad with zeroes only
-            int write_sample = audio_write_sample(audio_out, sample);
-            if(write_sample != 0) {
-                //debug("zero padding failed");
-                return -1;
+            for(int i = 0; i < n; i++) {
+                *(out + i) = (int16_t) *(tone + i);
             }
         }
+        sample_buf_len += n;
+        tone += n;
+        count -= n;
+        if(sample_buf_len == SAMPLE_BUF_SIZE && flush_samples(audio_out) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int set_zero_padding(FILE *audio_out, FILE *fp, int file_bool, int start, int end) {
+    //without noise, long gaps are written out in bulk (or skipped over in a regular file)
+    if(file_bool == 0 && end - start >= SILENCE_BULK_SAMPLES) {
+        if(flush_samples(audio_out) != 0 || audio_write_silence(audio_out, end - start) != 0)
+            return -1;
+        return 0;
+    }
+    //otherwise silence is written as a tone of all zeroes, so that it gets combined with any noise
+    for(int i = 0; i < SAMPLE_BUF_SIZE; i++) {
+        *(tone_buf + i) = 0;
+    }
+    for(int i = start; i < end; i += SAMPLE_BUF_SIZE) {
+        int count = end - i < SAMPLE_BUF_SIZE ? end - i : SAMPLE_BUF_SIZE;
+        if(write_tone(audio_out, fp, file_bool, tone_buf, count) != 0) {
+            //debug("zero padding failed");
+            return -1;
+        }
     }
     return 0;
 }
 
 /**
  * DTMF generation main function.
- * DTMF events are read (in textual tab-separated format) from the specified
- * input stream and audio data of a specified duration is written to the specified
+ * DTMF events are read (in textual tab-separated format, or in binary format
+ * if binary_events is set) from the specified input stream and audio data of a specified duration is written to the specified
  * output stream.  The DTMF events must be non-overlapping, in increasing order of
  * start index, and must lie completely within the specified duration.
  * The sample produced at a particular index will either be zero, if the index
@@ -184,7 +379,15 @@ int dtmf_generate(FILE *events_in, FILE *audio_out, uint32_t length) {
     //note: length = audio_samples
     int fr, fc;
     int prev_end = -1;
-    char *str = fgets(line_buf, LINE_BUF_SIZE, events_in);
+    //a binary events stream starts with its own header; text is read from scratch
+    text_pos = NULL;
+    text_end = NULL;
+    if(binary_events) {
+        event_buf_pos = 0;
+        event_buf_len = 0;
+        if(events_read_header(events_in) != 0)
+            return EOF;
+    }
     //check if a noise file has been given
     FILE *fp = fopen(noise_file, "r");
     int file_bool = 0;
@@ -200,17 +403,18 @@ int dtmf_generate(FILE *events_in, FILE *audio_out, uint32_t length) {
     AUDIO_HEADER header = {AUDIO_MAGIC, AUDIO_DATA_OFFSET, data_size,
         PCM16_ENCODING, AUDIO_FRAME_RATE, AUDIO_CHANNELS};
     int write_header = audio_write_header(audio_out, &header);
+    init_cos_table();
+    noise_weight = pow(10, noise_level/10.0) / (1 + pow(10, noise_level/10.0));
     if(write_header != 0) {
         //debug("generate write header failed");
         return EOF;
     }
-    //generate samples by reading one line at a time
-    while(str != NULL) {
-        //REMINDER: *(line_buf + i) is the same as line_buf[i] and line_buf = addr
-        //get DTMF event fields (ie. start & end indices and symbol)
-        char symbol;
-        int s_index, e_index;
-        get_event_fields(&s_index, &e_index, &symbol);
+    //generate samples by reading one event at a time
+    //get DTMF event fields (ie. start & end indices and symbol)
+    char symbol;
+    int s_index, e_index;
+    int more;
+    while((more = next_event(events_in, &s_index, &e_index, &symbol)) > 0) {
         //make sure indices are incrementing and events do not overlap
         if(s_index > e_index || s_index < prev_end || e_index > length) {
             //debug("index check failed");
@@ -234,41 +438,33 @@ int dtmf_generate(FILE *events_in, FILE *audio_out, uint32_t length) {
         }
         //set current end index to be previous end index
         prev_end = e_index;
-        //calculate each i sample
-        for(int i = s_index; i < e_index; i++) {
-            //get related i frequecy
-            if(find_symbol(symbol, &fr, &fc) < 0) {
+        //get related frequencies (only needed if the event has any samples)
+        if(s_index < e_index && find_symbol(symbol, &fr, &fc) < 0) {
+            return EOF;
+        }
+        //sample i of the tone is cos(2 * pi * f * i / AUDIO_FRAME_RATE) * 0.5 for each frequency,
+        //which is entry (f * i) % AUDIO_FRAME_RATE of cos_table
+        int pr = (int64_t) fr * s_index % AUDIO_FRAME_RATE;
+        int pc = (int64_t) fc * s_index % AUDIO_FRAME_RATE;
+        //synthesize and write out the samples a buffer at a time
+        for(int i = s_index; i < e_index; i += SAMPLE_BUF_SIZE) {
+            int count = e_index - i < SAMPLE_BUF_SIZE ? e_index - i : SAMPLE_BUF_SIZE;
+            synth_tone(tone_buf, count, fr, fc, &pr, &pc);
+            if(write_tone(audio_out, fp, file_bool, tone_buf, count) != 0)
                 return EOF;
-            }
-            //do calculations for each index and write to file
-            double fr_value = cos(2.0 * M_PI * fr * i / AUDIO_FRAME_RATE) * 0.5;
-            double fc_value = cos(2.0 * M_PI * fc * i / AUDIO_FRAME_RATE) * 0.5;
-            double dtmf_sample = (double)(fr_value + fc_value) * INT16_MAX;
-            //int16_t dtmf_sample = (int16_t)((fr_value + fc_value) * INT16_MAX);
-            //check if noise file was given
-            if(file_bool != 0) {
-                //if so combine with current dtmf_sample
-                int combine = combine_noise_file(fp, audio_out, dtmf_sample);
-                if(combine != 0)
-                    return EOF;
-            } else {
-                //if no noise file is given, write dtmf_sample to stdout
-                int write_sample = audio_write_sample(audio_out, (int16_t)dtmf_sample);
-                if(write_sample != 0) {
-                    //debug("generate write sample :264 failed");
-                    return EOF;
-                }
-            }
         }
-        //read next line from file
-        str = fgets(line_buf, LINE_BUF_SIZE, events_in);
     }
+    if(more < 0)
+        return EOF;
     //pad end of file with zeroes
     if(prev_end != -1) {
         int padding = set_zero_padding(audio_out, fp, file_bool, prev_end, length);
         if(padding != 0)
             return EOF;
     }
+    //write out whatever is left in the output buffer
+    if(flush_samples(audio_out) != 0)
+        return EOF;
     //close noise file (if any)
     if(file_bool != 0) {
         int close = fclose(fp);
@@ -278,63 +474,123 @@ int dtmf_generate(FILE *events_in, FILE *audio_out, uint32_t length) {
     return 0;
 }
 
-//helper function for determining frequency strengths
-int get_strengths(FILE *fp, int N, int *samples_read) {
-    //goertzel init
-    for(int i = 0; i < NUM_DTMF_FREQS; i++) {
-        double k = (double) *(dtmf_freqs + i)*N / AUDIO_FRAME_RATE;
-        goertzel_init(goertzel_state + i, N, k);
-    }
-    //goertzel step
-    double x;
-    int16_t sample;
-    for(int i = 0; i < N-1; i++) {
-        int read_sample = audio_read_sample(fp, &sample);
-        if(read_sample != 0 && !feof(fp))
-            return -1;
-        else if(feof(fp)) {
-            (*samples_read)--;
-            sample = 0;
-        }
-        (*samples_read)++;
-        x = (double) sample / INT16_MAX;
-        for(int j = 0; j < NUM_DTMF_FREQS; j++) {
-            goertzel_step(goertzel_state + j, x);
+//helper function to get a set of goertzel filters ready for the next block of N samples
+void setup_filters(GOERTZEL_STATE *states, int N, uint32_t rate, const TONE_PROFILE *tp) {
+    //goertzel init, worked out once per block size, rate and tone table and shared by every thread;
+    //a filter is only copied in when its block size or frequency changes, otherwise it is just started over
+    const GOERTZEL_STATE *coeffs = goertzel_cache_lookup(rate, N, tp -> freqs, tp -> num_freqs);
+    for(int i = 0; i < tp -> num_freqs; i++) {
+        if(coeffs == NULL) {
+            goertzel_init(states + i, N, (double) *(tp -> freqs + i)*N / rate);
+        } else if((states + i) -> N != (uint32_t) N || (states + i) -> k != (coeffs + i) -> k) {
+            *(states + i) = *(coeffs + i);
+        } else {
+            goertzel_reset(states + i);
         }
     }
+}
+
+//helper function to run the goertzel filters over a block of N samples
+void compute_strengths(const int16_t *block, int N, int big_endian, GOERTZEL_STATE *states,
+    double *strengths, const DETECT_OPTIONS *op) {
+    //goertzel step, all the filters at once, in fixed point (if the state fits) or double precision
+    int n = op -> profile -> num_freqs;
+    GOERTZEL_FIXED_BANK fixed_bank;
+    if(op -> fixed_point && goertzel_fixed_bank_load(&fixed_bank, states, n) == 0) {
+        goertzel_fixed_bank_run(&fixed_bank, block, N-1, big_endian);
+        goertzel_fixed_bank_store(&fixed_bank, states);
+    } else {
+        GOERTZEL_BANK bank;
+        goertzel_bank_load(&bank, states, n);
+        goertzel_bank_run(&bank, block, N-1, big_endian);
+        goertzel_bank_store(&bank, states);
+    }
     //goertzel strength
-    (*samples_read)++;
-    audio_read_sample(fp, &sample);
-    x = (double) sample / INT16_MAX;
-    for(int i = 0; i < NUM_DTMF_FREQS; i++) {
-        double strength = goertzel_strength(goertzel_state + i, x);
-        *(goertzel_strengths + i) = strength;
+    double x = (double) block_sample(block, N-1, big_endian) / INT16_MAX;
+    for(int i = 0; i < n; i++) {
+        double strength = goertzel_strength(states + i, x);
+        *(strengths + i) = strength;
     }
     /*for(int i = 0; i < NUM_DTMF_FREQS; i++) {
-        debug("%lf", *(goertzel_strengths + i));
+        debug("%lf", *(strengths + i));
     }*/
-    return 0;
+}
+
+//helper function to get the next block of N frames of C samples each, as one block of N samples
+//per channel: the block for channel c is at *blocks + c * N, and in big-endian byte order if
+//*big_endian is set on return.  Frames come from the mapped file if map is not NULL, otherwise
+//they are read from fp.  buf (DETECT_BUF_SIZE samples) holds any samples that cannot be used in place.
+//returns the number of frames read for the block (less than N at end of input), or -1 on error
+int get_blocks(FILE *fp, AUDIO_MAP *map, int N, int C, int64_t *frames_read, int16_t *buf,
+    const int16_t **blocks, int *big_endian) {
+    const int16_t *frames;
+    int n;
+    if(map != NULL) {
+        frames = map -> samples + *frames_read * C;
+        //the frames left can be more than an int holds, so they are only narrowed once clamped to N
+        int64_t left = (int64_t) (map -> num_samples / C) - *frames_read;
+        n = left < N ? (int) left : N;
+        *big_endian = 1;
+        //full monaural blocks are analyzed in place in the mapping
+        if(n == N && C == 1) {
+            *frames_read += N;
+            *blocks = frames;
+            return N;
+        }
+    } else {
+        //read the whole block at once; a partial frame at the end of input is dropped
+        n = audio_read_samples(fp, buf, N * C);
+        if(n == EOF)
+            return -1;
+        n /= C;
+        frames = buf;
+        *big_endian = 0;
+    }
+    *frames_read += n;
+    //monaural samples read from the stream are already in place; anything else is
+    //de-interleaved into the second half of buf
+    int16_t *out = buf;
+    if(map != NULL || C > 1) {
+        out = buf + DETECT_BUF_SIZE/2;
+        for(int c = 0; c < C; c++) {
+            for(int i = 0; i < n; i++) {
+                *(out + c * N + i) = block_sample(frames, i * C + c, *big_endian);
+            }
+        }
+    }
+    //a short final block is padded with zeroes
+    for(int c = 0; c < C; c++) {
+        for(int i = n; i < N; i++) {
+            *(out + c * N + i) = 0;
+        }
+    }
+    *blocks = out;
+    *big_endian = 0;
+    return n;
 }
 
 //helper function for finding greatest strengths
-int check_tone(double *sum, int *str_row_index, int *str_col_index) {
-    double str_row = *(goertzel_strengths);
-    double str_col = *(goertzel_strengths + 4);
+int check_tone(double *strengths, double *sum, int *str_row_index, int *str_col_index, const TONE_PROFILE *tp) {
+    //the tones of a symbol are the strongest row and the strongest column, or for a table of
+    //pairs (which has no rows) the two strongest tones of all
+    int n = tp -> num_freqs;
+    int rows = tp -> num_rows > 0 ? tp -> num_rows : n;
+    int cols = tp -> num_rows;
     //determine strongest row/col freq component
-    //calculate "other row freq components"
-    double row_sum, col_sum;
-    for(int i = 0; i < NUM_DTMF_FREQS/2; i++) {
-        row_sum += *(goertzel_strengths + i);
-        if(*(goertzel_strengths + i) > str_row) {
-            str_row = *(goertzel_strengths + i);
+    double str_row = *(strengths);
+    *str_row_index = 0;
+    for(int i = 0; i < rows; i++) {
+        if(*(strengths + i) > str_row) {
+            str_row = *(strengths + i);
             *str_row_index = i;
         }
     }
-    for(int i = NUM_DTMF_FREQS/2; i < NUM_DTMF_FREQS; i++) {
-        col_sum += *(goertzel_strengths + i);
-        if(*(goertzel_strengths + i) > str_col) {
-            str_col = *(goertzel_strengths + i);
-            *str_col_index = i - 4;
+    *str_col_index = cols == *str_row_index ? cols + 1 : cols;
+    double str_col = *(strengths + *str_col_index);
+    for(int i = cols; i < n; i++) {
+        if(i != *str_row_index && *(strengths + i) > str_col) {
+            str_col = *(strengths + i);
+            *str_col_index = i;
         }
     }
     //final values
@@ -342,37 +598,419 @@ int check_tone(double *sum, int *str_row_index, int *str_col_index) {
     double ratio = str_row / str_col;
     //debug("sum %lf, ratio %lf, str_row %lf, str_col %lf, %d r_i, %d c_i", *sum, ratio, str_row, str_col, *str_row_index, *str_col_index);
     //check if values are in range
-    if(*sum < MINUS_20DB) {
+    if(*sum < tp -> min_strength) {
         //debug("sum fail");
-        return -1;
+        return TONE_WEAK;
     }
-    if(ratio < (1/FOUR_DB) || ratio > FOUR_DB) {
+    if(ratio < (1/tp -> twist) || ratio > tp -> twist) {
         //debug("ratio fail");
-        return -1;
+        return TONE_TWIST;
     }
-    //check strongest row/col against other rows/cols
-    for(int i = 0; i < NUM_DTMF_FREQS/2; i++) {
+    //check strongest row/col against other rows/cols (for pairs, the other tone is not one of them)
+    for(int i = 0; i < rows; i++) {
         double str_row_ratio = 0;
-        if(str_row != *(goertzel_strengths+i)) {
-            //debug("current str %lf", *(goertzel_strengths+i));
-            str_row_ratio = str_row / *(goertzel_strengths + i);
-            if(str_row_ratio < SIX_DB) {
+        if(str_row != *(strengths+i) && i != *str_col_index) {
+            //debug("current str %lf", *(strengths+i));
+            str_row_ratio = str_row / *(strengths + i);
+            if(str_row_ratio < tp -> separation) {
                 //debug("str row ratio fail %lf", str_row_ratio);
-                return -1;
+                return TONE_ROW;
             }
         }
     }
-    for(int i = NUM_DTMF_FREQS/2; i < NUM_DTMF_FREQS; i++) {
+    for(int i = cols; i < n; i++) {
         double str_col_ratio = 0;
-        if(str_col != *(goertzel_strengths+i)) {
-            //debug("current str %lf", *(goertzel_strengths+i));
-            str_col_ratio = str_col / *(goertzel_strengths + i);
-            if(str_col_ratio < SIX_DB) {
+        if(str_col != *(strengths+i) && i != *str_row_index) {
+            //debug("current str %lf", *(strengths+i));
+            str_col_ratio = str_col / *(strengths + i);
+            if(str_col_ratio < tp -> separation) {
                 //debug("str col ratio fail %lf", str_col_ratio);
-                return -1;
+                return TONE_COLUMN;
             }
         }
     }
+    //in a table of pairs, not every pair need stand for a symbol
+    if(tone_symbol(tp, *str_row_index, *str_col_index) == '\0')
+        return TONE_NONE;
+    return TONE_FOUND;
+}
+
+//helper function to tell whether a block is too quiet for any two of its tones to reach min_strength
+//together (each is at most 2 * energy / (N * INT16_MAX^2)), with a factor of two to spare for rounding
+int quiet_block(const int16_t *block, int N, int big_endian, const TONE_PROFILE *tp) {
+    double energy = (double) goertzel_block_energy(block, N, big_endian) / ((double) INT16_MAX * INT16_MAX);
+    return 4 * energy / N < tp -> min_strength / 2;
+}
+
+//helper function to analyze one block of N samples for a DTMF tone, recording the outcome
+//quiet blocks are decided without running the filters, unless telemetry needs their strengths
+void decide_block(const int16_t *block, int N, uint32_t rate, int big_endian, GOERTZEL_STATE *states,
+    double *strengths, const DETECT_OPTIONS *op, DTMF_DECISION *dp) {
+    if(!op -> all_strengths && quiet_block(block, N, big_endian, op -> profile)) {
+        dp -> tone = TONE_WEAK;
+        dp -> sum = 0;
+        dp -> str_row_index = 0;
+        dp -> str_col_index = 0;
+        dp -> row_strength = 0;
+        dp -> col_strength = 0;
+        return;
+    }
+    setup_filters(states, N, rate, op -> profile);
+    compute_strengths(block, N, big_endian, states, strengths, op);
+    decide_strengths(strengths, op -> profile, dp);
+}
+
+//helper function to start out the event state for one channel of audio at the given rate, analyzed with the given settings
+void init_event(EVENT_STATE *ep, int channel, uint32_t rate, const DETECT_OPTIONS *op) {
+    ep -> symbol = '\0';
+    ep -> prev_symbol = '\0';
+    ep -> s_index = 0;
+    ep -> e_index = 0;
+    ep -> position = 0;
+    ep -> channel = channel;
+    ep -> rate = rate;
+    ep -> row_total = 0;
+    ep -> col_total = 0;
+    ep -> decisions = 0;
+    ep -> open = 0;
+    ep -> emit = NULL;
+    ep -> emit_arg = NULL;
+    ep -> options = op;
+}
+
+//helper function to write out a completed event
+//for multi-channel audio the line starts with the channel; in real-time mode it also gives
+//the detection latency, and is written out right away
+//in binary mode a record is written instead, with the average strengths over the event, and if the
+//event state has its own emit function the record is handed to that instead of being written
+void emit_event(EVENT_STATE *ep, char symbol, FILE *events_out) {
+    if(ep -> emit != NULL || binary_events) {
+        double n = ep -> decisions > 0 ? ep -> decisions : 1;
+        EVENT_RECORD record = { ep -> s_index, ep -> e_index, ep -> row_total / n, ep -> col_total / n,
+            ep -> channel, symbol };
+        if(ep -> emit != NULL) {
+            ep -> emit(ep -> emit_arg, &record);
+            return;
+        }
+        events_write_record(events_out, &record);
+        if(ep -> options -> onsets)
+            fflush(events_out);
+        return;
+    }
+    if(ep -> channel >= 0)
+        fprintf(events_out, "%d\t", ep -> channel);
+    fprintf(events_out, "%" PRId64 "\t%" PRId64 "\t%c", ep -> s_index, ep -> e_index, symbol);
+    if(ep -> options -> onsets) {
+        fprintf(events_out, "\t%" PRId64 "\n", ep -> position - ep -> e_index);
+        fflush(events_out);
+    } else {
+        fputc('\n', events_out);
+    }
+}
+
+//helper function to write out the start of the current event as soon as it is long enough to count,
+//in real-time mode: the line has "open" in place of the end index (or the record has an end of
+//EVENT_OPEN_END), and is followed later by the usual line for the whole event
+void emit_onset(EVENT_STATE *ep, FILE *events_out) {
+    ep -> open = 1;
+    if(binary_events) {
+        double n = ep -> decisions > 0 ? ep -> decisions : 1;
+        EVENT_RECORD record = { ep -> s_index, EVENT_OPEN_END, ep -> row_total / n, ep -> col_total / n,
+            ep -> channel, ep -> symbol };
+        events_write_record(events_out, &record);
+    } else {
+        if(ep -> channel >= 0)
+            fprintf(events_out, "%d\t", ep -> channel);
+        fprintf(events_out, "%" PRId64 "\topen\t%c\t%" PRId64 "\n", ep -> s_index, ep -> symbol,
+            ep -> position - ep -> e_index);
+    }
+    fflush(events_out);
+}
+
+//helper function to record the outcome of check_tone for a set of strengths
+void decide_strengths(double *strengths, const TONE_PROFILE *tp, DTMF_DECISION *dp) {
+    dp -> sum = 0;
+    dp -> str_row_index = 0;
+    dp -> str_col_index = 0;
+    dp -> tone = check_tone(strengths, &dp -> sum, &dp -> str_row_index, &dp -> str_col_index, tp);
+    dp -> row_strength = *(strengths + dp -> str_row_index);
+    dp -> col_strength = *(strengths + dp -> str_col_index);
+}
+
+//helper function to start the strength totals of the event over
+static void reset_strengths(EVENT_STATE *ep) {
+    ep -> row_total = 0;
+    ep -> col_total = 0;
+    ep -> decisions = 0;
+    ep -> open = 0;
+}
+
+//helper function to extend or end the current event, given the decision for the next step
+//samples; returns -1 if the decision makes no sense
+int update_event(EVENT_STATE *ep, const DTMF_DECISION *dp, int step, FILE *events_out) {
+    int tone = dp -> tone;
+    if(tone == 0 && dp -> sum != 0) {
+        ep -> prev_symbol = ep -> symbol;
+        ep -> symbol = tone_symbol(ep -> options -> profile, dp -> str_row_index, dp -> str_col_index);
+        //debug("if s %c, ps%c", ep -> symbol, ep -> prev_symbol);
+        if(ep -> symbol != ep -> prev_symbol && ep -> prev_symbol != '\0') {
+            if((ep -> e_index - ep -> s_index)/(double) ep -> rate >= ep -> options -> profile -> min_duration) {
+                //debug("valid duration valid tone %d, %d", ep -> s_index, ep -> e_index);
+                emit_event(ep, ep -> prev_symbol, events_out);
+                ep -> s_index = ep -> e_index;
+                reset_strengths(ep);
+            }
+        }
+        ep -> row_total += dp -> row_strength;
+        ep -> col_total += dp -> col_strength;
+        ep -> decisions++;
+        ep -> e_index += step;
+        //debug("valid %d, %d\n", ep -> s_index, ep -> e_index);
+        if(ep -> options -> onsets && !ep -> open && ep -> emit == NULL
+            && (ep -> e_index - ep -> s_index)/(double) ep -> rate >= ep -> options -> profile -> min_duration)
+            emit_onset(ep, events_out);
+    } else if(tone != 0) {
+        //debug("else if s %c, ps%c", ep -> symbol, ep -> prev_symbol);
+        if((ep -> e_index - ep -> s_index)/(double) ep -> rate >= ep -> options -> profile -> min_duration) {
+            //debug("valid duration invalid tone");
+            emit_event(ep, ep -> symbol, events_out);
+            ep -> s_index = ep -> e_index;
+        }
+        ep -> prev_symbol = '\0';
+        ep -> symbol = '\0';
+        reset_strengths(ep);
+        ep -> e_index += step;
+        ep -> s_index = ep -> e_index;
+        //debug("else if %d, %d", ep -> s_index, ep -> e_index);
+    } else return -1;
+    return 0;
+}
+
+//helper function to emit the event in progress (if long enough) once the end of input is reached
+void finish_event(EVENT_STATE *ep, int64_t samples_read, FILE *events_out) {
+    if((ep -> e_index - ep -> s_index)/(double) ep -> rate >= ep -> options -> profile -> min_duration) {
+        if(ep -> e_index > samples_read) {
+            ep -> e_index = samples_read;
+        }
+        ep -> position = samples_read;
+        emit_event(ep, ep -> prev_symbol, events_out);
+        ep -> s_index = ep -> e_index;
+    }
+}
+
+//detection over successive non-overlapping blocks of block_size (scaled to the rate) frames, each channel on its own
+//channels and buf are the working storage to be used: the state for each channel of the audio,
+//and a buffer of DETECT_BUF_SIZE samples
+int detect_blocks(FILE *audio_in, AUDIO_HEADER *hp, AUDIO_MAP *map, FILE *events_out,
+    DETECT_CHANNEL *channels, int16_t *buf) {
+    int N = block_frames(block_size, hp -> sample_rate);
+    int C = hp -> channels;
+    //with decimation, each block of N frames is analyzed as N/M samples at rate/M
+    //the decimation filter only passes the DTMF band, so tables with higher tones are not decimated
+    int M = decimate && tone_profile_max_freq(&tone_profile) <= DECIMATE_PASS_EDGE ?
+        decimate_factor(hp -> sample_rate, N) : 1;
+    for(int c = 0; c < C; c++) {
+        init_event(&(channels + c) -> event, C == 1 ? -1 : c, hp -> sample_rate, &detect_options);
+        if(M > 1)
+            decimator_init(&(channels + c) -> decimator, hp -> sample_rate, M);
+    }
+    //partition samples in N-frame partitions until end of file
+    int64_t samples_read = 0;
+    //a full block means there may be more input, so keep going until a short block is read
+    int n;
+    do {
+        const int16_t *blocks;
+        int big_endian;
+        n = get_blocks(audio_in, map, N, C, &samples_read, buf, &blocks, &big_endian);
+        //debug("%d frames", n);
+        if(n < 0)
+            return EOF;
+        //decimated samples go in whichever half of buf the blocks are not in
+        int16_t *decimated = blocks == buf ? buf + DETECT_BUF_SIZE/2 : buf;
+        for(int c = 0; c < C; c++) {
+            DETECT_CHANNEL *cp = channels + c;
+            DTMF_DECISION d;
+            if(M > 1) {
+                //the decimator takes at most DECIMATE_MAX_BLOCK samples (a whole number of M's) at a time
+                int chunk = DECIMATE_MAX_BLOCK / M * M;
+                for(int i = 0; i < N; i += chunk) {
+                    decimator_run(&cp -> decimator, blocks + c * N + i, N - i < chunk ? N - i : chunk,
+                        big_endian, decimated + c * (N / M) + i / M);
+                }
+                decide_block(decimated + c * (N / M), N / M, hp -> sample_rate / M, 0,
+                    cp -> states, cp -> strengths, &detect_options, &d);
+            } else {
+                decide_block(blocks + c * N, N, hp -> sample_rate, big_endian,
+                    cp -> states, cp -> strengths, &detect_options, &d);
+            }
+            //debug("%d tone", d.tone);
+            if(telemetry_file != NULL)
+                telemetry_block(c, samples_read - n, samples_read, cp -> strengths, &d);
+            cp -> event.position = samples_read;
+            if(update_event(&cp -> event, &d, N, events_out) != 0)
+                return EOF;
+        }
+    } while(n == N);
+    for(int c = 0; c < C; c++) {
+        finish_event(&(channels + c) -> event, samples_read, events_out);
+    }
+    return 0;
+}
+
+//helper function to read up to count frames of C samples (in host byte order) from the mapping or the stream
+//returns the number of frames read, or -1 on error
+int read_samples(FILE *fp, AUDIO_MAP *map, int16_t *samples, int count, int C, int64_t frames_read) {
+    if(map == NULL) {
+        int n = audio_read_samples(fp, samples, count * C);
+        return n == EOF ? -1 : n / C;
+    }
+    int64_t left = (int64_t) (map -> num_samples / C) - frames_read;
+    int n = left < count ? (int) left : count;
+    for(int i = 0; i < n * C; i++) {
+        *(samples + i) = block_sample(map -> samples + frames_read * C, i, 1);
+    }
+    return n;
+}
+
+//helper function to slide the window for channel c along by count frames of C samples
+void slide_window(int16_t *samples, int count, int C, int c, int N, int window_pos) {
+    int16_t *window = *(window_buf + c);
+    SLIDING_GOERTZEL_STATE *states = *(sliding_state + c);
+    for(int i = 0; i < count; i++) {
+        double x_new = (double) *(samples + i * C + c) / INT16_MAX;
+        double x_old = (double) *(window + window_pos) / INT16_MAX;
+        *(window + window_pos) = *(samples + i * C + c);
+        window_pos = (window_pos + 1) % N;
+        for(int j = 0; j < tone_profile.num_freqs; j++) {
+            sliding_goertzel_step(states + j, x_new, x_old);
+        }
+    }
+}
+
+//helper function to apply the decisions for the current windows to the event on each channel
+int decide_windows(int C, int N, int step, int64_t samples_read, FILE *events_out) {
+    for(int c = 0; c < C; c++) {
+        DETECT_CHANNEL *cp = detect_channels + c;
+        for(int i = 0; i < tone_profile.num_freqs; i++) {
+            *(cp -> strengths + i) = sliding_goertzel_strength(*(sliding_state + c) + i);
+        }
+        DTMF_DECISION d;
+        decide_strengths(cp -> strengths, detect_options.profile, &d);
+        if(telemetry_file != NULL)
+            telemetry_block(c, samples_read > N ? samples_read - N : 0, samples_read,
+                cp -> strengths, &d);
+        cp -> event.position = samples_read;
+        if(update_event(&cp -> event, &d, step, events_out) != 0)
+            return EOF;
+    }
+    return 0;
+}
+
+/*
+ * Detection over overlapping windows of block_size frames, advancing hop_size frames at a time
+ * (both scaled to the rate).
+ * The filters are sliding Goertzel filters, so each hop only costs O(hop_size).  The decision
+ * for each window is applied to the hop_size frames at its center, so event boundaries are
+ * accurate to about hop_size frames rather than block_size frames.  Each channel has its own
+ * filters, window and event.
+ */
+int detect_sliding(FILE *audio_in, AUDIO_HEADER *hp, AUDIO_MAP *map, FILE *events_out) {
+    int N = block_frames(block_size, hp -> sample_rate);
+    int hop = block_frames(hop_size, hp -> sample_rate);
+    int C = hp -> channels;
+    if(hop > N)
+        hop = N;
+    for(int c = 0; c < C; c++) {
+        for(int i = 0; i < tone_profile.num_freqs; i++) {
+            double k = (double) *(tone_profile.freqs + i)*N / hp -> sample_rate;
+            sliding_goertzel_init(*(sliding_state + c) + i, N, k);
+        }
+        //the window starts out empty (all zeroes) and is filled by sliding in the first N samples
+        for(int i = 0; i < N; i++) {
+            *(*(window_buf + c) + i) = 0;
+        }
+        init_event(&(detect_channels + c) -> event, C == 1 ? -1 : c, hp -> sample_rate, &detect_options);
+    }
+    int window_pos = 0;
+    int64_t samples_read = 0;
+    int n = read_samples(audio_in, map, detect_buf, N, C, samples_read);
+    if(n < 0)
+        return EOF;
+    samples_read += n;
+    for(int c = 0; c < C; c++) {
+        slide_window(detect_buf, n, C, c, N, window_pos);
+    }
+    window_pos = n % N;
+    //the first window also covers the samples before its center
+    int step = (N - hop)/2 + hop;
+    int more = (n == N);
+    while(1) {
+        if(decide_windows(C, N, step, samples_read, events_out) != 0)
+            return EOF;
+        if(!more)
+            break;
+        //slide in the next hop; a short final hop is padded with zeroes
+        n = read_samples(audio_in, map, detect_buf, hop, C, samples_read);
+        if(n < 0)
+            return EOF;
+        if(n == 0)
+            break;
+        samples_read += n;
+        for(int i = n * C; i < hop * C; i++) {
+            *(detect_buf + i) = 0;
+        }
+        for(int c = 0; c < C; c++) {
+            slide_window(detect_buf, hop, C, c, N, window_pos);
+        }
+        window_pos = (window_pos + hop) % N;
+        more = (n == hop);
+        step = hop;
+    }
+    //a tone still present in the last window runs right up to the end of the input
+    for(int c = 0; c < C; c++) {
+        EVENT_STATE *ep = &(detect_channels + c) -> event;
+        if(ep -> symbol != '\0' && samples_read > ep -> e_index)
+            ep -> e_index = samples_read;
+        finish_event(ep, samples_read, events_out);
+    }
+    return 0;
+}
+
+//helper function to scale a block size given in samples at AUDIO_FRAME_RATE to a number of frames at rate
+int block_frames(int size, uint32_t rate) {
+    int64_t frames = ((int64_t) size * rate + AUDIO_FRAME_RATE/2) / AUDIO_FRAME_RATE;
+    return frames > 0 ? frames : 1;
+}
+
+//helper function to tell whether audio at a rate can be analyzed: the tones have to be below the
+//Nyquist frequency to be told apart, and blocks must still hold at least MIN_BLOCK_SIZE frames
+int check_rate(uint32_t rate) {
+    if(2 * (uint32_t) tone_profile_max_freq(&tone_profile) >= rate)
+        return EOF;
+    if(block_frames(block_size, rate) < MIN_BLOCK_SIZE)
+        return EOF;
+    return 0;
+}
+
+//helper function to gather the settings of dtmf -d that the analysis of a stream depends on
+void get_detect_options(DETECT_OPTIONS *op) {
+    op -> profile = &tone_profile;
+    op -> fixed_point = fixed_point;
+    op -> all_strengths = telemetry_file != NULL;
+    op -> onsets = realtime;
+}
+
+//helper function to read and validate the header of an audio input, straight from memory if
+//the input is a regular file; *mapp is set to the mapping, or to NULL for the stream path
+int open_audio(FILE *audio_in, AUDIO_HEADER *hp, AUDIO_MAP *map, AUDIO_MAP **mapp) {
+    *mapp = NULL;
+    int map_file = audio_map_file(audio_in, hp, map);
+    if(map_file == EOF)
+        return EOF;
+    else if(map_file == 0)
+        *mapp = map;
+    else if(audio_read_header_any(audio_in, hp) == EOF)
+        return EOF;
     return 0;
 }
 
@@ -397,74 +1035,72 @@ int check_tone(double *sum, int *str_row_index, int *str_col_index) {
  * read is used as the ending index of any current DTMF event and this final event is emitted
  * if its length is at least MIN_DTMF_DURATION.
  *
+ * If hop_size is nonzero (and differs from block_size), the blocks overlap instead: a new block
+ * starts every hop_size samples, and each block decides the hop_size samples at its center.
+ * If coarse_factor is nonzero, blocks that do not overlap are analyzed first, and only those
+ * around the start or end of a tone are analyzed again, in overlapping steps (see detect_coarse).
+ *
+ * The filters are tuned to the sample rate given in the header.  block_size and hop_size count
+ * samples at AUDIO_FRAME_RATE, and are scaled to that rate (see block_frames), so a block covers
+ * the same span of time at any rate; if that leaves fewer than MIN_BLOCK_SIZE frames per block,
+ * EOF is returned without analyzing anything.  If the audio has more than one
+ * channel, each channel is analyzed on its own (all in the same pass over the input), indices
+ * count frames rather than samples, and each line of output starts with the channel number and
+ * a tab.  Multi-channel audio is always analyzed by a single thread.
+ *
+ * If decimate is nonzero, high-rate audio is low-pass filtered and decimated before each block
+ * is analyzed (see decimate.h); this is also always done by a single thread.
+ *
+ * If realtime is nonzero, each event is written out twice, each time flushed right away: once
+ * with "open" in place of the end index as soon as it has lasted the minimum duration, and again
+ * as usual as soon as its end has been detected.  Both lines have the detection latency (the
+ * number of samples read past the part of the event decided so far) as an extra field.  Memory
+ * use does not grow with the length of the input.
+ *
  *   @param audio_in  Input stream from which to read audio header and sample data.
  *   @param events_out  Output stream to which DTMF events are to be written.
  *   @return 0  If reading of audio and writing of DTMF events is sucessful, EOF otherwise.
  */
 int dtmf_detect(FILE *audio_in, FILE *events_out) {
     // TO BE IMPLEMENTED
-    //read and validate header from input stream
     AUDIO_HEADER header;
-    int read_header = audio_read_header(audio_in, &header);
-    if(read_header == EOF)
-        return EOF;
-    //partition samples in block_size partitions until end of file
-    char symbol = '\0', prev_symbol = '\0';
-    int s_index = 0, e_index = 0, samples_read = 0;
-    while(!feof(audio_in)) {
-        double sum = 0;
-        int str_row_index = 0;
-        int str_col_index = 0;
-        int g_strengths = get_strengths(audio_in, block_size, &samples_read);
-        //debug("%d strengths", g_strengths);
-        if(g_strengths != 0 && !feof(audio_in))
+    AUDIO_MAP map;
+    AUDIO_MAP *mapp = NULL;
+    get_detect_options(&detect_options);
+    //in real-time mode the input is always read as a stream, since it may still be growing
+    if(realtime) {
+        if(audio_read_header_any(audio_in, &header) == EOF)
             return EOF;
-        else {
-            int tone = check_tone(&sum, &str_row_index, &str_col_index);
-            //debug("%d tone", tone);
-            if(tone == 0 && sum != 0) {
-                prev_symbol = symbol;
-                symbol = *(*(dtmf_symbol_names + str_row_index) + str_col_index);
-                //debug("if s %c, ps%c", symbol, prev_symbol);
-                //e_index += block_size;
-                //debug("%c, %c", symbol,prev_symbol);
-                if(symbol != prev_symbol && prev_symbol != '\0') {
-                    if((e_index - s_index)/8000.0 >= MIN_DTMF_DURATION) {
-                        //debug("valid duration valid tone %d, %d", s_index, e_index);
-                        fprintf(events_out, "%d\t%d\t%c\n", s_index, e_index, prev_symbol);
-                        s_index = e_index;
-                    }
-                }
-                e_index += block_size;
-                //debug("valid %d, %d\n", s_index, e_index);
-            } else if(tone != 0) {
-                //debug("else if s %c, ps%c", symbol, prev_symbol);
-                //e_index += block_size;
-                if((e_index - s_index)/8000.0 >= MIN_DTMF_DURATION) {
-                    //debug("valid duration invalid tone");
-                    fprintf(events_out, "%d\t%d\t%c\n", s_index, e_index, symbol);
-                    s_index = e_index;
-                }
-                prev_symbol = '\0';
-                symbol = '\0';
-                e_index += block_size;
-                s_index = e_index;
-                //debug("else if %d, %d", s_index, e_index);
-            } else return EOF;
-        }
+    } else if(open_audio(audio_in, &header, &map, &mapp) == EOF) {
+        return EOF;
     }
-    if(feof(audio_in)) {
-        samples_read--;
-        //debug("%d", samples_read);
-        if((e_index - s_index)/8000.0 >= MIN_DTMF_DURATION) {
-            if(e_index > samples_read) {
-                e_index = samples_read;
-            }
-            fprintf(events_out, "%d\t%d\t%c\n", s_index, e_index, prev_symbol);
-            s_index = e_index;
-        }
+    if(check_rate(header.sample_rate) != 0) {
+        if(mapp != NULL)
+            audio_unmap_file(mapp);
+        return EOF;
     }
-    return 0;
+    if(telemetry_file != NULL && telemetry_open(telemetry_file) != 0) {
+        if(mapp != NULL)
+            audio_unmap_file(mapp);
+        return EOF;
+    }
+    int ret;
+    //a binary events stream starts with its own header
+    if(binary_events && events_write_header(events_out) != 0)
+        ret = EOF;
+    else if(hop_size != 0 && hop_size != block_size)
+        ret = detect_sliding(audio_in, &header, mapp, events_out);
+    else if(coarse_factor > 1)
+        ret = detect_coarse(audio_in, &header, mapp, events_out);
+    else if(num_threads > 1 && header.channels == 1 && !decimate)
+        ret = detect_parallel(audio_in, &header, mapp, events_out);
+    else
+        ret = detect_blocks(audio_in, &header, mapp, events_out, detect_channels, detect_buf);
+    if(mapp != NULL)
+        audio_unmap_file(mapp);
+    if(telemetry_file != NULL && telemetry_close() != 0)
+        ret = EOF;
+    return ret;
 }
 
 //helper function for validation
@@ -476,6 +1112,23 @@ int extract_int_arg(char *arg, int *num_out) {
         return str_to_num(arg, num_out);
 }
 
+//helper function to tell how many arguments a generate-only flag takes up (with its value), or 0 if it is not one
+int generate_flag_args(char *flag) {
+    if(str_comp(flag, "-t") == 0 || str_comp(flag, "-n") == 0 || str_comp(flag, "-l") == 0)
+        return 2;
+    return 0;
+}
+
+//helper function to tell how many arguments a detect-only flag takes up (with its value), or 0 if it is not one
+int detect_flag_args(char *flag) {
+    if(str_comp(flag, "-b") == 0 || str_comp(flag, "-s") == 0 || str_comp(flag, "-j") == 0
+        || str_comp(flag, "-B") == 0 || str_comp(flag, "-T") == 0 || str_comp(flag, "-C") == 0)
+        return 2;
+    if(str_comp(flag, "-r") == 0 || str_comp(flag, "-D") == 0 || str_comp(flag, "-F") == 0)
+        return 1;
+    return 0;
+}
+
 //generate args helper function
 int validate_generate_args(int argc, char **argv) {
     //vars used for globals -- set to zero each time (from global vars)
@@ -486,6 +1139,11 @@ int validate_generate_args(int argc, char **argv) {
     int t_flag = 0;
     int n_flag = 0;
     int l_flag = 0;
+    int binary_arg = 0;
+    char *profile_arg = "dtmf";
+    int P_flag = 0;
+    //in loopback mode the detect flags are left to validate_detect_args, and vice versa
+    int loopback = str_comp(*(argv + 1), "-L") == 0;
     for(int i = 2; i < argc; i++) {
         char *current = *(argv + i);
         if(str_comp(current, "-t") == 0) {
@@ -524,36 +1182,153 @@ int validate_generate_args(int argc, char **argv) {
                     return -1;
                 i++;                 //increment index to go to next flag
             }
+        } else if(str_comp(current, "-E") == 0 && binary_arg == 0) {
+            binary_arg = 1;
+        } else if(str_comp(current, "-P") == 0 && P_flag == 0) {
+            P_flag = 1;
+            profile_arg = *(argv + (i + 1));
+            if(profile_arg == NULL)
+                return -1;
+            i++;                 //increment index to go to next flag
+        } else if(loopback && detect_flag_args(current) > 0) {
+            i += detect_flag_args(current) - 1;
         } else {
             return -1;
         }
     }
+    //the profile is loaded last, so that nothing is changed if the arguments are not valid
+    TONE_PROFILE profile;
+    if(tone_profile_load(profile_arg, &profile) != 0)
+        return -1;
     global_options = GENERATE_OPTION;
+    tone_profile = profile;
     audio_samples = msec_arg;
     noise_file = noisefile_arg;
     noise_level = level_arg;
+    binary_events = binary_arg;
     return 0;
 }
 
 //detect args helper function
 int validate_detect_args(int argc, char **argv) {
-    int blocksize_arg;
-    if(argc > 4)
-        return -1;
-    else if(argc == 2)
-        blocksize_arg = DEFAULT_BLOCK_SIZE;
-    else {
-        char *current = *(argv + 2);
-        if(str_comp(current, "-b") == 0) {
-            current = *(argv + 3);
+    int blocksize_arg = DEFAULT_BLOCK_SIZE;
+    int hop_arg = 0;
+    int threads_arg = 1;
+    char *list_arg = NULL;
+    char *telemetry_arg = NULL;
+    int realtime_arg = 0;
+    int decimate_arg = 0;
+    int fixed_arg = 0;
+    int binary_arg = 0;
+    char *profile_arg = "dtmf";
+    int P_flag = 0;
+    //vars used to keep track of selections (to avoid repeated flags)
+    int b_flag = 0;
+    int s_flag = 0;
+    int j_flag = 0;
+    int B_flag = 0;
+    int coarse_arg = 0;
+    int loopback = str_comp(*(argv + 1), "-L") == 0;
+    for(int i = 2; i < argc; i++) {
+        char *current = *(argv + i);
+        if(str_comp(current, "-b") == 0 && b_flag == 0) {
+            b_flag = 1;
+            current = *(argv + (i + 1));
             if(extract_int_arg(current, &blocksize_arg) < 0)
                 return -1;
-            else if(blocksize_arg < 10 && blocksize_arg > 1000)
+            else if(blocksize_arg < MIN_BLOCK_SIZE || blocksize_arg > MAX_BLOCK_SIZE)
+                return -1;
+            i++;                 //increment index to go to next flag
+        } else if(str_comp(current, "-s") == 0 && s_flag == 0) {
+            s_flag = 1;
+            current = *(argv + (i + 1));
+            if(extract_int_arg(current, &hop_arg) < 0 || hop_arg < 1)
+                return -1;
+            i++;                 //increment index to go to next flag
+        } else if(str_comp(current, "-j") == 0 && j_flag == 0) {
+            j_flag = 1;
+            current = *(argv + (i + 1));
+            if(extract_int_arg(current, &threads_arg) < 0)
+                return -1;
+            else if(threads_arg < 1 || threads_arg > MAX_DETECT_THREADS)
+                return -1;
+            i++;                 //increment index to go to next flag
+        } else if(str_comp(current, "-B") == 0 && B_flag == 0) {
+            B_flag = 1;
+            list_arg = *(argv + (i + 1));
+            if(list_arg == NULL)
+                return -1;
+            i++;                 //increment index to go to next flag
+        } else if(str_comp(current, "-T") == 0 && telemetry_arg == NULL) {
+            telemetry_arg = *(argv + (i + 1));
+            if(telemetry_arg == NULL)
                 return -1;
-        } else return -1;
+            i++;                 //increment index to go to next flag
+        } else if(str_comp(current, "-C") == 0 && coarse_arg == 0) {
+            current = *(argv + (i + 1));
+            if(extract_int_arg(current, &coarse_arg) < 0 || coarse_arg < 2 || coarse_arg > 64)
+                return -1;
+            i++;                 //increment index to go to next flag
+        } else if(str_comp(current, "-r") == 0 && realtime_arg == 0) {
+            realtime_arg = 1;
+        } else if(str_comp(current, "-D") == 0 && decimate_arg == 0) {
+            decimate_arg = 1;
+        } else if(str_comp(current, "-F") == 0 && fixed_arg == 0) {
+            fixed_arg = 1;
+        } else if(str_comp(current, "-E") == 0 && binary_arg == 0) {
+            binary_arg = 1;
+        } else if(str_comp(current, "-P") == 0 && P_flag == 0) {
+            P_flag = 1;
+            profile_arg = *(argv + (i + 1));
+            if(profile_arg == NULL)
+                return -1;
+            i++;                 //increment index to go to next flag
+        } else if(loopback && generate_flag_args(current) > 0) {
+            i += generate_flag_args(current) - 1;
+        } else {
+            return -1;
+        }
     }
+    //the hop can be checked against the block size only once both are known
+    if(hop_arg > blocksize_arg)
+        return -1;
+    //batch detection only does non-overlapping blocks
+    if(list_arg != NULL && hop_arg != 0 && hop_arg != blocksize_arg)
+        return -1;
+    //loopback detects in the audio generated from standard input, not in a list of files
+    if(loopback && list_arg != NULL)
+        return -1;
+    //batch output puts the pathname in front of each line, so it has to be text
+    if(binary_arg && list_arg != NULL)
+        return -1;
+    //telemetry is written in order, as the decisions are made, for one stream
+    if(telemetry_arg != NULL && (list_arg != NULL || threads_arg > 1))
+        return -1;
+    //real-time detection works on one stream, a block at a time
+    if(realtime_arg && (list_arg != NULL || threads_arg > 1))
+        return -1;
+    //the fine steps are at least one sample each, and are laid over non-overlapping blocks of the whole file
+    if(coarse_arg != 0 && (coarse_arg > blocksize_arg || (hop_arg != 0 && hop_arg != blocksize_arg)
+        || threads_arg > 1 || list_arg != NULL || telemetry_arg != NULL || realtime_arg || decimate_arg))
+        return -1;
+    //decimation and fixed point are done block by block, so they do not go with overlapping blocks
+    if((decimate_arg || fixed_arg) && hop_arg != 0 && hop_arg != blocksize_arg)
+        return -1;
+    TONE_PROFILE profile;
+    if(tone_profile_load(profile_arg, &profile) != 0)
+        return -1;
     global_options = DETECT_OPTION;
+    tone_profile = profile;
     block_size = blocksize_arg;
+    hop_size = hop_arg;
+    num_threads = threads_arg;
+    batch_list = list_arg;
+    telemetry_file = telemetry_arg;
+    realtime = realtime_arg;
+    decimate = decimate_arg;
+    fixed_point = fixed_arg;
+    binary_events = binary_arg;
+    coarse_factor = coarse_arg;
     return 0;
 }
 
@@ -562,7 +1337,7 @@ int validate_detect_args(int argc, char **argv) {
  * @details This function will validate all the arguments passed to the
  * program, returning 0 if validation succeeds and -1 if validation fails.
  * Upon successful return, the operation mode of the program (help, generate,
- * or detect) will be recorded in the global variable `global_options`,
+ * detect or loopback) will be recorded in the global variable `global_options`,
  * where it will be accessible elsewhere in the program.
  * Global variables `audio_samples`, `noise file`, `noise_level`, and `block_size`
  * will also be set, either to values derived from specified `-t`, `-n`, `-l` and `-b`
@@ -589,6 +1364,10 @@ int validargs(int argc, char **argv)
     } else if(str_comp(cmd, "-d") == 0) {
         if(validate_detect_args(argc, argv) != 0)
             return -1;
+    } else if(str_comp(cmd, "-L") == 0) {
+        if(validate_generate_args(argc, argv) != 0 || validate_detect_args(argc, argv) != 0)
+            return -1;
+        global_options = LOOPBACK_OPTION;
     } else {
         return -1;
     }
@@ -0,0 +1,70 @@
+#include <stdio.h>
+
+#include "events.h"
+#include "debug.h"
+
+//helper function to swap the multi-byte fields of a record between little-endian and host order
+static void swap_record(EVENT_RECORD *rp) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    rp -> start = __builtin_bswap64(rp -> start);
+    rp -> end = __builtin_bswap64(rp -> end);
+    uint32_t *row = (uint32_t *) &rp -> row_strength;
+    *row = __builtin_bswap32(*row);
+    uint32_t *col = (uint32_t *) &rp -> col_strength;
+    *col = __builtin_bswap32(*col);
+#endif
+}
+
+int events_write_header(FILE *out) {
+    const char *magic = EVENTS_MAGIC;
+    for(int i = 0; i < 4; i++) {
+        if(fputc(*(magic + i), out) == EOF)
+            return EOF;
+    }
+    //version and record size, little-endian
+    int fields[2] = { EVENTS_VERSION, EVENT_RECORD_SIZE };
+    for(int i = 0; i < 2; i++) {
+        if(fputc(*(fields + i) & 0xff, out) == EOF || fputc(*(fields + i) >> 8, out) == EOF)
+            return EOF;
+    }
+    return 0;
+}
+
+int events_read_header(FILE *in) {
+    unsigned char header[EVENT_HEADER_SIZE];
+    if(fread(header, 1, EVENT_HEADER_SIZE, in) != EVENT_HEADER_SIZE)
+        return EOF;
+    const char *magic = EVENTS_MAGIC;
+    for(int i = 0; i < 4; i++) {
+        if(*(header + i) != (unsigned char) *(magic + i))
+            return EOF;
+    }
+    int version = *(header + 4) | (*(header + 5) << 8);
+    int record_size = *(header + 6) | (*(header + 7) << 8);
+    if(version != EVENTS_VERSION || record_size != EVENT_RECORD_SIZE)
+        return EOF;
+    return 0;
+}
+
+int events_write_record(FILE *out, const EVENT_RECORD *rp) {
+    EVENT_RECORD record = *rp;
+    for(int i = 0; i < 6; i++) {
+        *(record.reserved + i) = 0;
+    }
+    swap_record(&record);
+    if(fwrite(&record, EVENT_RECORD_SIZE, 1, out) != 1)
+        return EOF;
+    return 0;
+}
+
+int events_read_records(FILE *in, EVENT_RECORD *records, int count) {
+    //read bytes rather than records, so that a record cut off by the end of the input is noticed
+    size_t bytes = fread(records, 1, (size_t) count * EVENT_RECORD_SIZE, in);
+    if(bytes < (size_t) count * EVENT_RECORD_SIZE && (ferror(in) || bytes % EVENT_RECORD_SIZE != 0))
+        return EOF;
+    size_t n = bytes / EVENT_RECORD_SIZE;
+    for(size_t i = 0; i < n; i++) {
+        swap_record(records + i);
+    }
+    return n;
+}
@@ -1,8 +1,13 @@
 #include <stdint.h>
 #include <math.h>
+#include <pthread.h>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
 
 #include "debug.h"
 #include "goertzel.h"
+#include "goertzel_bank.h"
 
 void goertzel_init(GOERTZEL_STATE *gp, uint32_t N, double k) {
     // TO BE IMPLEMENTED
@@ -12,11 +17,49 @@ void goertzel_init(GOERTZEL_STATE *gp, uint32_t N, double k) {
     gp -> k = k;
     gp -> A = a;
     gp -> B = b;
+    goertzel_reset(gp);
+}
+
+void goertzel_reset(GOERTZEL_STATE *gp) {
     gp -> s0 = 0;
     gp -> s1 = 0;
     gp -> s2 = 0;
 }
 
+/*
+ * Per-thread memo of the constants used to form C and D, which only depend on A and N, so that
+ * goertzel_strength does not have to work them out again for every block.  It is direct-mapped,
+ * indexed by a hash of A and N; an entry with N = 0 has not been used yet.
+ */
+#define FINISH_MEMO_BITS 6
+
+typedef struct goertzel_finish {
+    double A;
+    uint32_t N;
+    double cos_A;    // cos(A) and sin(A), used to form C = e^-jA.
+    double sin_A;
+    double cos_AN;   // cos(A(N-1)) and sin(A(N-1)), used to form D.
+    double sin_AN;
+} GOERTZEL_FINISH;
+
+static __thread GOERTZEL_FINISH finish_memo[1 << FINISH_MEMO_BITS];
+
+//helper function to get the constants used to finish a filter, working them out if they are not in the memo
+static const GOERTZEL_FINISH *finish_constants(const GOERTZEL_STATE *gp) {
+    union { double d; uint64_t u; } a = { .d = gp -> A };
+    uint64_t h = (a.u ^ gp -> N) * 0x9e3779b97f4a7c15ull;
+    GOERTZEL_FINISH *fp = finish_memo + (h >> (64 - FINISH_MEMO_BITS));
+    if(fp -> N != gp -> N || fp -> A != gp -> A) {
+        fp -> A = gp -> A;
+        fp -> N = gp -> N;
+        fp -> cos_A = cos(gp -> A);
+        fp -> sin_A = sin(gp -> A);
+        fp -> cos_AN = cos(gp -> A * (gp -> N - 1));
+        fp -> sin_AN = sin(gp -> A * (gp -> N - 1));
+    }
+    return fp;
+}
+
 void goertzel_step(GOERTZEL_STATE *gp, double x) {
     // TO BE IMPLEMENTED
     gp -> s0 = x + (gp -> B * gp -> s1) - gp -> s2;
@@ -37,13 +80,352 @@ double goertzel_strength(GOERTZEL_STATE *gp, double x) {
     * y = part1 + part2 so then y^2 = part1^2 + part2^2
     * return (2*y^2)/N^2
     */
+    const GOERTZEL_FINISH *fp = finish_constants(gp);
     gp -> s0 = x + (gp -> B * gp -> s1) - gp -> s2;
-    double a = gp -> s0 - (gp -> s1 * cos(gp -> A));        //s0 - s1(cosA)
-    double b = gp -> s1 * sin(gp -> A);                     //s1 * sinA
-    double c = cos(gp -> A * (gp -> N - 1));                //cosA * N-1
-    double d = sin(gp -> A * (gp -> N - 1));                //sinA * N-1
+    double a = gp -> s0 - (gp -> s1 * fp -> cos_A);        //s0 - s1(cosA)
+    double b = gp -> s1 * fp -> sin_A;                      //s1 * sinA
+    double c = fp -> cos_AN;                                //cosA * N-1
+    double d = fp -> sin_AN;                                //sinA * N-1
     double p = (a * c) - (b * d);                           //a
     double q = (a * d) + (b * c);                           //b
     double y = (p * p) + (q * q);                           //y^2 = a^2 + b^2
     return (2 * y)/(gp -> N * gp -> N);                     //2*y^2/N^2
 }
+
+void sliding_goertzel_init(SLIDING_GOERTZEL_STATE *sp, uint32_t N, double k) {
+    double a = 2 * M_PI * (k/N);
+    sp -> N = N;
+    sp -> k = k;
+    sp -> cos_A = cos(a);
+    sp -> sin_A = sin(a);
+    sp -> cos_AN = cos(a * (N - 1));
+    sp -> sin_AN = sin(a * (N - 1));
+    sp -> re = 0;
+    sp -> im = 0;
+}
+
+void sliding_goertzel_step(SLIDING_GOERTZEL_STATE *sp, double x_new, double x_old) {
+    //drop the oldest sample and rotate everything else back by one sample ...
+    double re = sp -> re - x_old;
+    double im = sp -> im;
+    double r = (re * sp -> cos_A) - (im * sp -> sin_A);
+    double i = (re * sp -> sin_A) + (im * sp -> cos_A);
+    //... then add the new sample in at position N-1
+    sp -> re = r + (x_new * sp -> cos_AN);
+    sp -> im = i - (x_new * sp -> sin_AN);
+}
+
+double sliding_goertzel_strength(SLIDING_GOERTZEL_STATE *sp) {
+    double y = (sp -> re * sp -> re) + (sp -> im * sp -> im);
+    return (2 * y)/((double) sp -> N * sp -> N);
+}
+
+//helper function to get the number of lanes used by a bank of n filters: whole groups, the rest zero
+static int bank_lanes(int n) {
+    return (n + GOERTZEL_BANK_GROUP - 1) / GOERTZEL_BANK_GROUP * GOERTZEL_BANK_GROUP;
+}
+
+void goertzel_bank_load(GOERTZEL_BANK *bp, GOERTZEL_STATE *gp, int n) {
+    bp -> n = n;
+    for(int i = 0; i < bank_lanes(n); i++) {
+        if(i < n) {
+            *(bp -> B + i) = (gp + i) -> B;
+            *(bp -> s1 + i) = (gp + i) -> s1;
+            *(bp -> s2 + i) = (gp + i) -> s2;
+        } else {
+            *(bp -> B + i) = 0;
+            *(bp -> s1 + i) = 0;
+            *(bp -> s2 + i) = 0;
+        }
+    }
+}
+
+void goertzel_bank_store(GOERTZEL_BANK *bp, GOERTZEL_STATE *gp) {
+    //s0 always equals s1 after a step, so it is not kept in the bank
+    for(int i = 0; i < bp -> n; i++) {
+        (gp + i) -> s0 = *(bp -> s1 + i);
+        (gp + i) -> s1 = *(bp -> s1 + i);
+        (gp + i) -> s2 = *(bp -> s2 + i);
+    }
+}
+
+//helper function to convert sample i to the filter input, swapping it out of big-endian order if need be
+static inline __attribute__((always_inline)) double bank_input(const int16_t *samples, int i, int big_endian) {
+    int16_t sample = *(samples + i);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if(big_endian)
+        sample = (int16_t) __builtin_bswap16(sample);
+#endif
+    return (double) sample / INT16_MAX;
+}
+
+//plain scalar kernel, same arithmetic as goertzel_step
+static void bank_run_scalar(GOERTZEL_BANK *bp, const int16_t *samples, int count, int big_endian) {
+    for(int i = 0; i < count; i++) {
+        double x = bank_input(samples, i, big_endian);
+        for(int j = 0; j < bp -> n; j++) {
+            double s0 = x + (*(bp -> B + j) * *(bp -> s1 + j)) - *(bp -> s2 + j);
+            *(bp -> s2 + j) = *(bp -> s1 + j);
+            *(bp -> s1 + j) = s0;
+        }
+    }
+}
+
+#ifdef __x86_64__
+//SSE2 kernel: eight filters in four lanes of two doubles, kept in registers for the whole block
+static void bank_run_sse2(const double *B, double *s1, double *s2, const int16_t *samples, int count,
+    int big_endian) {
+    __m128d b0 = _mm_load_pd(B), b1 = _mm_load_pd(B + 2);
+    __m128d b2 = _mm_load_pd(B + 4), b3 = _mm_load_pd(B + 6);
+    __m128d p0 = _mm_load_pd(s1), p1 = _mm_load_pd(s1 + 2);
+    __m128d p2 = _mm_load_pd(s1 + 4), p3 = _mm_load_pd(s1 + 6);
+    __m128d q0 = _mm_load_pd(s2), q1 = _mm_load_pd(s2 + 2);
+    __m128d q2 = _mm_load_pd(s2 + 4), q3 = _mm_load_pd(s2 + 6);
+    for(int i = 0; i < count; i++) {
+        __m128d x = _mm_set1_pd(bank_input(samples, i, big_endian));
+        //s0 = (x + B * s1) - s2, in the same order as goertzel_step
+        __m128d r0 = _mm_sub_pd(_mm_add_pd(x, _mm_mul_pd(b0, p0)), q0);
+        __m128d r1 = _mm_sub_pd(_mm_add_pd(x, _mm_mul_pd(b1, p1)), q1);
+        __m128d r2 = _mm_sub_pd(_mm_add_pd(x, _mm_mul_pd(b2, p2)), q2);
+        __m128d r3 = _mm_sub_pd(_mm_add_pd(x, _mm_mul_pd(b3, p3)), q3);
+        q0 = p0; q1 = p1; q2 = p2; q3 = p3;
+        p0 = r0; p1 = r1; p2 = r2; p3 = r3;
+    }
+    _mm_store_pd(s1, p0); _mm_store_pd(s1 + 2, p1);
+    _mm_store_pd(s1 + 4, p2); _mm_store_pd(s1 + 6, p3);
+    _mm_store_pd(s2, q0); _mm_store_pd(s2 + 2, q1);
+    _mm_store_pd(s2 + 4, q2); _mm_store_pd(s2 + 6, q3);
+}
+
+//AVX2 kernel: eight filters in two lanes of four doubles
+__attribute__((target("avx2")))
+static void bank_run_avx2(const double *B, double *s1, double *s2, const int16_t *samples, int count,
+    int big_endian) {
+    __m256d b0 = _mm256_load_pd(B), b1 = _mm256_load_pd(B + 4);
+    __m256d p0 = _mm256_load_pd(s1), p1 = _mm256_load_pd(s1 + 4);
+    __m256d q0 = _mm256_load_pd(s2), q1 = _mm256_load_pd(s2 + 4);
+    for(int i = 0; i < count; i++) {
+        __m256d x = _mm256_set1_pd(bank_input(samples, i, big_endian));
+        //s0 = (x + B * s1) - s2, in the same order as goertzel_step (no fused multiply-add)
+        __m256d r0 = _mm256_sub_pd(_mm256_add_pd(x, _mm256_mul_pd(b0, p0)), q0);
+        __m256d r1 = _mm256_sub_pd(_mm256_add_pd(x, _mm256_mul_pd(b1, p1)), q1);
+        q0 = p0; q1 = p1;
+        p0 = r0; p1 = r1;
+    }
+    _mm256_store_pd(s1, p0); _mm256_store_pd(s1 + 4, p1);
+    _mm256_store_pd(s2, q0); _mm256_store_pd(s2 + 4, q1);
+    //avoid AVX/SSE transition stalls in the (non-VEX) caller; gcc leaves this out at -O0
+    _mm256_zeroupper();
+}
+#endif
+
+void goertzel_bank_run(GOERTZEL_BANK *bp, const int16_t *samples, int count, int big_endian) {
+#ifdef __x86_64__
+    //the kernels step a group of eight filters, so a bigger bank takes one pass over the samples per group
+    int avx2 = __builtin_cpu_supports("avx2");
+    for(int g = 0; g < bp -> n; g += GOERTZEL_BANK_GROUP) {
+        if(avx2)
+            bank_run_avx2(bp -> B + g, bp -> s1 + g, bp -> s2 + g, samples, count, big_endian);
+        else
+            bank_run_sse2(bp -> B + g, bp -> s1 + g, bp -> s2 + g, samples, count, big_endian);
+    }
+#else
+    bank_run_scalar(bp, samples, count, big_endian);
+#endif
+}
+
+int goertzel_fixed_bank_load(GOERTZEL_FIXED_BANK *bp, GOERTZEL_STATE *gp, int n) {
+    bp -> n = n;
+    for(int i = 0; i < bank_lanes(n); i++) {
+        if(i < n) {
+            const GOERTZEL_FINISH *fp = finish_constants(gp + i);
+            //the state can reach N/sin(A) times the largest sample; keep it well inside 32 bits
+            if((gp + i) -> N >= 49152 * fabs(fp -> sin_A))
+                return -1;
+            //cos(A) < 1 for every frequency above zero, but rounding could still carry it to 2^31
+            double c = round(fp -> cos_A * 2147483648.0);
+            *(bp -> c + i) = c > INT32_MAX ? INT32_MAX : (int32_t) c;
+            *(bp -> s1 + i) = (int32_t) lround((gp + i) -> s1 * INT16_MAX);
+            *(bp -> s2 + i) = (int32_t) lround((gp + i) -> s2 * INT16_MAX);
+        } else {
+            *(bp -> c + i) = 0;
+            *(bp -> s1 + i) = 0;
+            *(bp -> s2 + i) = 0;
+        }
+    }
+    return 0;
+}
+
+void goertzel_fixed_bank_store(GOERTZEL_FIXED_BANK *bp, GOERTZEL_STATE *gp) {
+    for(int i = 0; i < bp -> n; i++) {
+        (gp + i) -> s0 = (double) *(bp -> s1 + i) / INT16_MAX;
+        (gp + i) -> s1 = (double) *(bp -> s1 + i) / INT16_MAX;
+        (gp + i) -> s2 = (double) *(bp -> s2 + i) / INT16_MAX;
+    }
+}
+
+//helper function to get sample i as a Q15 value, swapping it out of big-endian order if need be
+static inline __attribute__((always_inline)) int32_t fixed_input(const int16_t *samples, int i, int big_endian) {
+    int16_t sample = *(samples + i);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if(big_endian)
+        sample = (int16_t) __builtin_bswap16(sample);
+#endif
+    return sample;
+}
+
+//plain scalar kernel for a group of eight filters; all lanes are stepped (unused ones are zero), so
+//the inner loop has a fixed trip count and no dependencies between lanes, and can be vectorized by
+//the compiler where the target has 32x32->64-bit multiplies.  The product alone can reach about
+//2 * 1.5 * 2^30, past INT32_MAX, so the whole step is worked out in 64 bits and only s0 (which the
+//load guard keeps within 1.5 * 2^30) is narrowed.
+static void fixed_bank_run_scalar(const int32_t *c, int32_t *s1, int32_t *s2, const int16_t *samples,
+    int count, int big_endian) {
+    for(int i = 0; i < count; i++) {
+        int32_t x = fixed_input(samples, i, big_endian);
+        for(int j = 0; j < GOERTZEL_BANK_GROUP; j++) {
+            int32_t s0 = (int32_t) (x + (((int64_t) *(c + j) * *(s1 + j)) >> 30) - *(s2 + j));
+            *(s2 + j) = *(s1 + j);
+            *(s1 + j) = s0;
+        }
+    }
+}
+
+#ifdef __x86_64__
+//AVX2 kernel: eight filters in one vector of 32-bit lanes.  The 64-bit products are formed
+//for the even and odd lanes separately; bits 30-61 of each product are the same whether it
+//is shifted arithmetically or logically, so the logical shift AVX2 has will do.  The lanes
+//wrap around modulo 2^32, which gives the same s0 as the scalar kernel whenever s0 itself fits.
+__attribute__((target("avx2")))
+static void fixed_bank_run_avx2(const int32_t *c, int32_t *s1, int32_t *s2, const int16_t *samples,
+    int count, int big_endian) {
+    __m256i c_even = _mm256_load_si256((const __m256i *) c);
+    __m256i c_odd = _mm256_srli_epi64(c_even, 32);
+    __m256i p = _mm256_load_si256((const __m256i *) s1);
+    __m256i q = _mm256_load_si256((const __m256i *) s2);
+    for(int i = 0; i < count; i++) {
+        __m256i x = _mm256_set1_epi32(fixed_input(samples, i, big_endian));
+        __m256i even = _mm256_srli_epi64(_mm256_mul_epi32(c_even, p), 30);
+        __m256i odd = _mm256_srli_epi64(_mm256_mul_epi32(c_odd, _mm256_srli_epi64(p, 32)), 30);
+        __m256i prod = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa);
+        __m256i r = _mm256_sub_epi32(_mm256_add_epi32(x, prod), q);
+        q = p;
+        p = r;
+    }
+    _mm256_store_si256((__m256i *) s1, p);
+    _mm256_store_si256((__m256i *) s2, q);
+    //avoid AVX/SSE transition stalls in the (non-VEX) caller
+    _mm256_zeroupper();
+}
+#endif
+
+void goertzel_fixed_bank_run(GOERTZEL_FIXED_BANK *bp, const int16_t *samples, int count, int big_endian) {
+#ifdef __x86_64__
+    int avx2 = __builtin_cpu_supports("avx2");
+#endif
+    for(int g = 0; g < bp -> n; g += GOERTZEL_BANK_GROUP) {
+#ifdef __x86_64__
+        if(avx2) {
+            fixed_bank_run_avx2(bp -> c + g, bp -> s1 + g, bp -> s2 + g, samples, count, big_endian);
+            continue;
+        }
+#endif
+        fixed_bank_run_scalar(bp -> c + g, bp -> s1 + g, bp -> s2 + g, samples, count, big_endian);
+    }
+}
+
+uint64_t goertzel_block_energy(const int16_t *samples, int count, int big_endian) {
+    uint64_t energy = 0;
+    int i = 0;
+#ifdef __x86_64__
+    //pmaddwd sums the squares of two samples, which is at most 2^31 and so fits in an unsigned
+    //32-bit lane; those are widened to 64 bits before they are added up
+    __m128i zero = _mm_setzero_si128();
+    __m128i total = zero;
+    for(; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (samples + i));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if(big_endian)
+            x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+#endif
+        __m128i squares = _mm_madd_epi16(x, x);
+        total = _mm_add_epi64(total, _mm_unpacklo_epi32(squares, zero));
+        total = _mm_add_epi64(total, _mm_unpackhi_epi32(squares, zero));
+    }
+    energy = (uint64_t) _mm_cvtsi128_si64(total) + (uint64_t) _mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total));
+#endif
+    for(; i < count; i++) {
+        int16_t x = *(samples + i);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if(big_endian)
+            x = (int16_t) __builtin_bswap16(x);
+#endif
+        energy += (uint64_t) ((int32_t) x * x);
+    }
+    return energy;
+}
+
+//one set of filters in the coefficient cache, and what it was worked out for
+typedef struct goertzel_cache_entry {
+    uint32_t rate;
+    uint32_t N;
+    int count;
+    int freqs[GOERTZEL_BANK_SIZE];
+    GOERTZEL_STATE states[GOERTZEL_BANK_SIZE];
+} GOERTZEL_CACHE_ENTRY;
+
+/*
+ * Entries are only ever added, under cache_mutex, and each is filled in before cache_used
+ * is raised past it (with release ordering), so readers that load cache_used (with acquire
+ * ordering) can look at the entries below it without taking the lock.
+ */
+static GOERTZEL_CACHE_ENTRY cache[GOERTZEL_CACHE_SIZE];
+static int cache_used;
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+//the entry this thread found last, which is nearly always the one it wants next
+static __thread int cache_last;
+
+//helper function to tell whether a cache entry is the one for a frequency table
+static int cache_match(const GOERTZEL_CACHE_ENTRY *ep, uint32_t rate, uint32_t N, const int *freqs, int count) {
+    if(ep -> rate != rate || ep -> N != N || ep -> count != count)
+        return 0;
+    for(int i = 0; i < count; i++) {
+        if(*(ep -> freqs + i) != *(freqs + i))
+            return 0;
+    }
+    return 1;
+}
+
+//helper function to find the entry for a frequency table among the first used entries, or -1
+static int cache_find(int used, uint32_t rate, uint32_t N, const int *freqs, int count) {
+    if(cache_last < used && cache_match(cache + cache_last, rate, N, freqs, count))
+        return cache_last;
+    for(int e = 0; e < used; e++) {
+        if(cache_match(cache + e, rate, N, freqs, count))
+            return cache_last = e;
+    }
+    return -1;
+}
+
+const GOERTZEL_STATE *goertzel_cache_lookup(uint32_t rate, uint32_t N, const int *freqs, int count) {
+    int e = cache_find(__atomic_load_n(&cache_used, __ATOMIC_ACQUIRE), rate, N, freqs, count);
+    if(e >= 0)
+        return (cache + e) -> states;
+    //another thread may have added it since, so look again under the lock before adding it
+    pthread_mutex_lock(&cache_mutex);
+    e = cache_find(cache_used, rate, N, freqs, count);
+    if(e < 0 && cache_used < GOERTZEL_CACHE_SIZE) {
+        GOERTZEL_CACHE_ENTRY *ep = cache + cache_used;
+        ep -> rate = rate;
+        ep -> N = N;
+        ep -> count = count;
+        for(int i = 0; i < count; i++) {
+            *(ep -> freqs + i) = *(freqs + i);
+            goertzel_init(ep -> states + i, N, (double) *(freqs + i) * N / rate);
+        }
+        e = cache_last = cache_used;
+        __atomic_store_n(&cache_used, cache_used + 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&cache_mutex);
+    return e >= 0 ? (cache + e) -> states : NULL;
+}
@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "const.h"
+#include "loopback.h"
+#include "debug.h"
+
+/*
+ * The ring is written only by the generator thread and read only by the detector
+ * (single producer, single consumer), so the bytes themselves are copied outside the
+ * lock; the mutex only guards the running totals and the closed flags.  ring_in
+ * and ring_out count every byte that has passed through, so the ring holds
+ * ring_in - ring_out bytes, starting at ring_out % LOOPBACK_RING_SIZE.
+ */
+static char ring[LOOPBACK_RING_SIZE];
+static size_t ring_in;
+static size_t ring_out;
+static int writer_closed;
+static int reader_closed;
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ring_not_full = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ring_not_empty = PTHREAD_COND_INITIALIZER;
+
+//stdio buffers for the two ends, so that opening them does not allocate any
+static char writer_buf[LOOPBACK_STREAM_BUF_SIZE];
+static char reader_buf[LOOPBACK_STREAM_BUF_SIZE];
+
+//arguments and result of the generator thread
+static FILE *generate_events_in;
+static FILE *generate_audio_out;
+static uint32_t generate_len;
+static int generate_ret;
+
+//write function of the generator's end: blocks while the ring is full
+static ssize_t ring_write(void *cookie, const char *buf, size_t size) {
+    size_t done = 0;
+    pthread_mutex_lock(&ring_mutex);
+    while(done < size) {
+        while(ring_in - ring_out == LOOPBACK_RING_SIZE && !reader_closed)
+            pthread_cond_wait(&ring_not_full, &ring_mutex);
+        //nobody is going to read the rest
+        if(reader_closed) {
+            pthread_mutex_unlock(&ring_mutex);
+            errno = EPIPE;
+            return -1;
+        }
+        size_t offset = ring_in % LOOPBACK_RING_SIZE;
+        size_t n = LOOPBACK_RING_SIZE - (ring_in - ring_out);
+        n = n < size - done ? n : size - done;
+        n = n < LOOPBACK_RING_SIZE - offset ? n : LOOPBACK_RING_SIZE - offset;
+        pthread_mutex_unlock(&ring_mutex);
+        memcpy(ring + offset, buf + done, n);
+        pthread_mutex_lock(&ring_mutex);
+        ring_in += n;
+        done += n;
+        pthread_cond_signal(&ring_not_empty);
+    }
+    pthread_mutex_unlock(&ring_mutex);
+    return size;
+}
+
+//read function of the detector's end: blocks while the ring is empty, until the generator is done
+static ssize_t ring_read(void *cookie, char *buf, size_t size) {
+    pthread_mutex_lock(&ring_mutex);
+    while(ring_in == ring_out && !writer_closed)
+        pthread_cond_wait(&ring_not_empty, &ring_mutex);
+    size_t offset = ring_out % LOOPBACK_RING_SIZE;
+    size_t n = ring_in - ring_out;
+    n = n < size ? n : size;
+    n = n < LOOPBACK_RING_SIZE - offset ? n : LOOPBACK_RING_SIZE - offset;
+    pthread_mutex_unlock(&ring_mutex);
+    //an empty ring with the writer closed is the end of the audio
+    if(n == 0)
+        return 0;
+    memcpy(buf, ring + offset, n);
+    pthread_mutex_lock(&ring_mutex);
+    ring_out += n;
+    pthread_cond_signal(&ring_not_full);
+    pthread_mutex_unlock(&ring_mutex);
+    return n;
+}
+
+static int ring_close_writer(void *cookie) {
+    pthread_mutex_lock(&ring_mutex);
+    writer_closed = 1;
+    pthread_cond_signal(&ring_not_empty);
+    pthread_mutex_unlock(&ring_mutex);
+    return 0;
+}
+
+static int ring_close_reader(void *cookie) {
+    pthread_mutex_lock(&ring_mutex);
+    reader_closed = 1;
+    pthread_cond_signal(&ring_not_full);
+    pthread_mutex_unlock(&ring_mutex);
+    return 0;
+}
+
+//main function of the generator thread
+static void *generator_main(void *arg) {
+    generate_ret = dtmf_generate(generate_events_in, generate_audio_out, generate_len);
+    //closing flushes what is left and lets the detector see the end of the audio
+    if(fclose(generate_audio_out) != 0)
+        generate_ret = EOF;
+    return NULL;
+}
+
+int dtmf_loopback(FILE *events_in, FILE *events_out, uint32_t len) {
+    cookie_io_functions_t writer_io = { NULL, ring_write, NULL, ring_close_writer };
+    cookie_io_functions_t reader_io = { ring_read, NULL, NULL, ring_close_reader };
+    ring_in = 0;
+    ring_out = 0;
+    writer_closed = 0;
+    reader_closed = 0;
+    FILE *audio_out = fopencookie(NULL, "w", writer_io);
+    if(audio_out == NULL)
+        return EOF;
+    FILE *audio_in = fopencookie(NULL, "r", reader_io);
+    if(audio_in == NULL) {
+        fclose(audio_out);
+        return EOF;
+    }
+    setvbuf(audio_out, writer_buf, _IOFBF, LOOPBACK_STREAM_BUF_SIZE);
+    setvbuf(audio_in, reader_buf, _IOFBF, LOOPBACK_STREAM_BUF_SIZE);
+    generate_events_in = events_in;
+    generate_audio_out = audio_out;
+    generate_len = len;
+    pthread_t generator;
+    if(pthread_create(&generator, NULL, generator_main, NULL) != 0) {
+        fclose(audio_out);
+        fclose(audio_in);
+        return EOF;
+    }
+    int ret = dtmf_detect(audio_in, events_out);
+    //if detection stopped early, closing the reader also stops the generator
+    fclose(audio_in);
+    pthread_join(generator, NULL);
+    return ret == 0 && generate_ret == 0 ? 0 : EOF;
+}
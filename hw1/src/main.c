@@ -2,6 +2,8 @@
 #include <stdlib.h>
 
 #include "const.h"
+#include "options.h"
+#include "loopback.h"
 #include "debug.h"
 
 #ifdef _STRING_H
@@ -20,11 +22,11 @@ int main(int argc, char **argv)
 {
     if(validargs(argc, argv)) {
       //debug("g %d, t %d, file %s, l %d, b %d", global_options, audio_samples, noise_file, noise_level, block_size);
-      USAGE(*argv, EXIT_FAILURE);
+      DTMF_USAGE(*argv, EXIT_FAILURE);
     }
     if(global_options & 1) {
       //debug("g %d, t %d, file %s, l %d, b %d", global_options, audio_samples, noise_file, noise_level, block_size);
-      USAGE(*argv, EXIT_SUCCESS);
+      DTMF_USAGE(*argv, EXIT_SUCCESS);
     }
     // TO BE IMPLEMENTED
     else if(global_options & GENERATE_OPTION) {
@@ -35,8 +37,17 @@ int main(int argc, char **argv)
         return EXIT_SUCCESS;
       else return EXIT_FAILURE;
     }
+    else if(global_options & LOOPBACK_OPTION) {
+      if(dtmf_loopback(stdin, stdout, audio_samples) == 0)
+        return EXIT_SUCCESS;
+      else return EXIT_FAILURE;
+    }
     else if(global_options & DETECT_OPTION) {
-      int detect = dtmf_detect(stdin, stdout);
+      int detect;
+      if(batch_list != NULL)
+        detect = dtmf_detect_batch(batch_list, stdout);
+      else
+        detect = dtmf_detect(stdin, stdout);
       //debug("%d", detect);
       //debug("g %d, t %d, file %s, l %d, b %d", global_options, audio_samples, noise_file, noise_level, block_size);
       if(detect == 0)
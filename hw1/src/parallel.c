@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "const.h"
+#include "audio.h"
+#include "detect.h"
+#include "options.h"
+#include "buffers.h"
+#include "debug.h"
+
+/*
+ * Parallel DTMF detection.
+ * The input is taken a "round" at a time: as many whole blocks as fit in round_buf
+ * (or the same number of blocks straight out of the mapped file).  The blocks of a
+ * round are split into one contiguous slice per worker thread, and each worker records
+ * the check_tone outcome for each of its blocks in decision_buf.  Once all the workers
+ * are done, the main thread replays the decisions in order through update_event, exactly
+ * as detect_blocks would have made them, so the events written are byte-for-byte the same.
+ * The last (short or empty) block is analyzed by the main thread on its own.
+ */
+
+//description of the round currently being analyzed, set by the main thread between rounds
+static const int16_t *round_samples;
+static int round_big_endian;
+static int round_blocks;
+static int round_block_size;
+static uint32_t round_rate;
+static int round_stop;
+
+//round_number counts rounds handed out; workers_busy counts workers not yet done with this one
+static unsigned long round_number;
+static int workers_busy;
+static pthread_mutex_t round_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t round_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t round_done = PTHREAD_COND_INITIALIZER;
+
+//number of worker threads actually running
+static int workers_started;
+
+//main function of each worker thread
+static void *detect_worker_main(void *arg) {
+    DETECT_WORKER *wp = arg;
+    while(1) {
+        //wait for the next round
+        pthread_mutex_lock(&round_mutex);
+        while(wp -> round == round_number && !round_stop)
+            pthread_cond_wait(&round_start, &round_mutex);
+        if(round_stop) {
+            pthread_mutex_unlock(&round_mutex);
+            return NULL;
+        }
+        wp -> round = round_number;
+        pthread_mutex_unlock(&round_mutex);
+        //analyze this worker's slice of the round
+        int N = round_block_size;
+        long first = (long) round_blocks * wp -> index / workers_started;
+        long last = (long) round_blocks * (wp -> index + 1) / workers_started;
+        for(long b = first; b < last; b++) {
+            decide_block(round_samples + b * N, N, round_rate, round_big_endian, wp -> channels -> states,
+                wp -> channels -> strengths, &detect_options, decision_buf + b);
+        }
+        //let the main thread know once everyone is done
+        pthread_mutex_lock(&round_mutex);
+        workers_busy--;
+        if(workers_busy == 0)
+            pthread_cond_signal(&round_done);
+        pthread_mutex_unlock(&round_mutex);
+    }
+}
+
+//helper function to start up to num_threads workers; returns the number started
+static int start_workers(void) {
+    round_stop = 0;
+    round_number = 0;
+    workers_started = 0;
+    for(int i = 0; i < num_threads && i < MAX_DETECT_THREADS; i++) {
+        DETECT_WORKER *wp = detect_workers + i;
+        wp -> index = i;
+        wp -> round = 0;
+        //zero N forces setup_filters to initialize this worker's filters on first use
+        for(int j = 0; j < tone_profile.num_freqs; j++) {
+            (wp -> channels -> states + j) -> N = 0;
+        }
+        if(pthread_create(&wp -> thread, NULL, detect_worker_main, wp) != 0)
+            break;
+        workers_started++;
+    }
+    return workers_started;
+}
+
+//helper function to tell the workers to exit and wait for them
+static void stop_workers(void) {
+    pthread_mutex_lock(&round_mutex);
+    round_stop = 1;
+    pthread_cond_broadcast(&round_start);
+    pthread_mutex_unlock(&round_mutex);
+    for(int i = 0; i < workers_started; i++) {
+        pthread_join((detect_workers + i) -> thread, NULL);
+    }
+    workers_started = 0;
+}
+
+//helper function to have the workers analyze a round of blocks, returning once they all finish
+static void run_round(const int16_t *samples, int big_endian, int blocks, int N, uint32_t rate) {
+    pthread_mutex_lock(&round_mutex);
+    round_rate = rate;
+    round_samples = samples;
+    round_big_endian = big_endian;
+    round_blocks = blocks;
+    round_block_size = N;
+    workers_busy = workers_started;
+    round_number++;
+    pthread_cond_broadcast(&round_start);
+    while(workers_busy > 0)
+        pthread_cond_wait(&round_done, &round_mutex);
+    pthread_mutex_unlock(&round_mutex);
+}
+
+int detect_parallel(FILE *audio_in, AUDIO_HEADER *hp, AUDIO_MAP *map, FILE *events_out) {
+    int N = block_frames(block_size, hp -> sample_rate);
+    int max_blocks = DETECT_ROUND_SAMPLES / N;
+    if(start_workers() == 0)
+        return EOF;
+    EVENT_STATE event;
+    init_event(&event, -1, hp -> sample_rate, &detect_options);
+    int64_t samples_read = 0;
+    int ret = 0;
+    while(1) {
+        //gather a round of whole blocks, either in place in the mapping or read into round_buf
+        const int16_t *samples;
+        int big_endian, blocks, leftover;
+        if(map != NULL) {
+            //a round takes at most max_blocks blocks, so there is no need to count past that
+            int64_t left = (int64_t) map -> num_samples - samples_read;
+            int available = left < (int64_t) max_blocks * N ? (int) left : max_blocks * N;
+            samples = map -> samples + samples_read;
+            big_endian = 1;
+            blocks = available / N < max_blocks ? available / N : max_blocks;
+            leftover = available - blocks * N;
+        } else {
+            int n = audio_read_samples(audio_in, round_buf, max_blocks * N);
+            if(n == EOF) {
+                ret = EOF;
+                break;
+            }
+            samples = round_buf;
+            big_endian = 0;
+            blocks = n / N;
+            leftover = n - blocks * N;
+        }
+        if(blocks > 0)
+            run_round(samples, big_endian, blocks, N, hp -> sample_rate);
+        //build up the events in order, just as detect_blocks would
+        for(int b = 0; b < blocks && ret == 0; b++) {
+            DTMF_DECISION *dp = decision_buf + b;
+            event.position = samples_read + (int64_t) (b + 1) * N;
+            if(update_event(&event, dp, N, events_out) != 0)
+                ret = EOF;
+        }
+        samples_read += blocks * N;
+        if(ret != 0)
+            break;
+        if(blocks == max_blocks)
+            continue;
+        //a short round means the input is done; what is left over makes up the final block
+        //(in detect_buf, which belongs to detection, since a generator may be using sample_buf)
+        for(int i = 0; i < N; i++) {
+            *(detect_buf + i) = i < leftover ? block_sample(samples + blocks * N, i, big_endian) : 0;
+        }
+        samples_read += leftover;
+        DTMF_DECISION last;
+        decide_block(detect_buf, N, hp -> sample_rate, 0, detect_channels -> states,
+            detect_channels -> strengths, &detect_options, &last);
+        event.position = samples_read;
+        if(update_event(&event, &last, N, events_out) != 0)
+            ret = EOF;
+        break;
+    }
+    stop_workers();
+    if(ret == 0)
+        finish_event(&event, samples_read, events_out);
+    return ret;
+}
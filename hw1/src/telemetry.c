@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <math.h>
+#include <inttypes.h>
+
+#include "const.h"
+#include "telemetry.h"
+#include "debug.h"
+
+static FILE *telemetry_out;
+
+//counts of each verdict, indexed by -check_tone (so TONE_FOUND comes first)
+#define NUM_VERDICTS 6
+static const char *verdict_names[NUM_VERDICTS] = { "tone", "weak", "twist", "row", "column", "none" };
+static long verdict_counts[NUM_VERDICTS];
+
+static long sum_histogram[TELEMETRY_SUM_BINS];
+static long twist_histogram[TELEMETRY_TWIST_BINS];
+
+//helper function to express a ratio of strengths in dB; zero strength comes out as -inf
+static double to_db(double ratio) {
+    return 10 * log10(ratio);
+}
+
+//helper function to find the histogram bin for a value, with the ends catching everything beyond them
+static int bin_of(double value, int min, int width, int bins) {
+    if(isnan(value))
+        return 0;
+    double bin = floor((value - min) / width);
+    if(bin < 0)
+        return 0;
+    if(bin > bins - 1)
+        return bins - 1;
+    return (int) bin;
+}
+
+int telemetry_open(const char *path) {
+    telemetry_out = fopen(path, "w");
+    if(telemetry_out == NULL)
+        return EOF;
+    for(int i = 0; i < NUM_VERDICTS; i++) {
+        *(verdict_counts + i) = 0;
+    }
+    for(int i = 0; i < TELEMETRY_SUM_BINS; i++) {
+        *(sum_histogram + i) = 0;
+    }
+    for(int i = 0; i < TELEMETRY_TWIST_BINS; i++) {
+        *(twist_histogram + i) = 0;
+    }
+    fprintf(telemetry_out, "#channel\tstart\tend");
+    for(int i = 0; i < tone_profile.num_freqs; i++) {
+        fprintf(telemetry_out, "\t%d", *(tone_profile.freqs + i));
+    }
+    fprintf(telemetry_out, "\tsum_db\ttwist_db\tverdict\n");
+    return 0;
+}
+
+void telemetry_block(int channel, int64_t start, int64_t end, const double *strengths,
+    const DTMF_DECISION *dp) {
+    double sum_db = to_db(dp -> sum);
+    double twist_db = to_db(dp -> row_strength / dp -> col_strength);
+    fprintf(telemetry_out, "%d\t%" PRId64 "\t%" PRId64, channel, start, end);
+    for(int i = 0; i < tone_profile.num_freqs; i++) {
+        fprintf(telemetry_out, "\t%.6g", *(strengths + i));
+    }
+    fprintf(telemetry_out, "\t%.2f\t%.2f\t", sum_db, twist_db);
+    if(dp -> tone == TONE_FOUND)
+        fputc(tone_symbol(&tone_profile, dp -> str_row_index, dp -> str_col_index), telemetry_out);
+    else
+        fputs(*(verdict_names - dp -> tone), telemetry_out);
+    fputc('\n', telemetry_out);
+    (*(verdict_counts - dp -> tone))++;
+    (*(sum_histogram + bin_of(sum_db, TELEMETRY_SUM_MIN_DB, TELEMETRY_SUM_BIN_DB, TELEMETRY_SUM_BINS)))++;
+    //the twist only means something once the tone is strong enough to be checked for it
+    if(dp -> tone != TONE_WEAK)
+        (*(twist_histogram + bin_of(twist_db, TELEMETRY_TWIST_MIN_DB, 1, TELEMETRY_TWIST_BINS)))++;
+}
+
+int telemetry_close(void) {
+    fprintf(telemetry_out, "#verdict\tcount\n");
+    for(int i = 0; i < NUM_VERDICTS; i++) {
+        fprintf(telemetry_out, "#%s\t%ld\n", *(verdict_names + i), *(verdict_counts + i));
+    }
+    //each bin is labeled with its lower edge; the first and last bins also hold everything beyond
+    fprintf(telemetry_out, "#sum_db\tcount\n");
+    for(int i = 0; i < TELEMETRY_SUM_BINS; i++) {
+        if(*(sum_histogram + i) != 0)
+            fprintf(telemetry_out, "#%d\t%ld\n", TELEMETRY_SUM_MIN_DB + i * TELEMETRY_SUM_BIN_DB,
+                *(sum_histogram + i));
+    }
+    fprintf(telemetry_out, "#twist_db\tcount\n");
+    for(int i = 0; i < TELEMETRY_TWIST_BINS; i++) {
+        if(*(twist_histogram + i) != 0)
+            fprintf(telemetry_out, "#%d\t%ld\n", TELEMETRY_TWIST_MIN_DB + i, *(twist_histogram + i));
+    }
+    int ret = fclose(telemetry_out);
+    telemetry_out = NULL;
+    return ret == 0 ? 0 : EOF;
+}
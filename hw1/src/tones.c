@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "const.h"
+#include "tones.h"
+#include "debug.h"
+
+//the DTMF profile, which is also the default; the thresholds are the compile-time ones exactly
+#define DTMF_PROFILE { \
+    .num_freqs = 8, \
+    .num_rows = 4, \
+    .freqs = { 697, 770, 852, 941, 1209, 1336, 1477, 1633 }, \
+    .symbols = { \
+        [0] = { [4] = '1', [5] = '2', [6] = '3', [7] = 'A' }, \
+        [1] = { [4] = '4', [5] = '5', [6] = '6', [7] = 'B' }, \
+        [2] = { [4] = '7', [5] = '8', [6] = '9', [7] = 'C' }, \
+        [3] = { [4] = '*', [5] = '0', [6] = '#', [7] = 'D' }, \
+    }, \
+    .twist = FOUR_DB, \
+    .separation = SIX_DB, \
+    .min_strength = MINUS_20DB, \
+    .min_duration = MIN_DTMF_DURATION, \
+}
+
+TONE_PROFILE tone_profile = DTMF_PROFILE;
+
+static const TONE_PROFILE dtmf_profile = DTMF_PROFILE;
+
+//MF R1 (inter-office multi-frequency signalling): any two of six tones; KP is 'K', ST is 'S',
+//and ST', ST'' and ST''' are 'X', 'Y' and 'Z'
+static const TONE_PROFILE mfr1_profile = {
+    .num_freqs = 6,
+    .num_rows = 0,
+    .freqs = { 700, 900, 1100, 1300, 1500, 1700 },
+    .symbols = {
+        [0] = { [1] = '1', [2] = '2', [3] = '4', [4] = '7', [5] = 'Z' },
+        [1] = { [2] = '3', [3] = '5', [4] = '8', [5] = 'X' },
+        [2] = { [3] = '6', [4] = '9', [5] = 'K' },
+        [3] = { [4] = '0', [5] = 'Y' },
+        [4] = { [5] = 'S' },
+    },
+    .twist = 3.981071706,       // 6 dB
+    .separation = SIX_DB,
+    .min_strength = MINUS_20DB,
+    .min_duration = 0.04,
+};
+
+//helper function to convert a ratio in dB to a plain ratio of strengths
+static double from_db(double db) {
+    return pow(10, db / 10);
+}
+
+//helper function to read a list of frequencies into the table, after the ones already there
+//returns the number read, or -1 if any of them is not valid
+static int read_freqs(char *rest, TONE_PROFILE *tp) {
+    int count = 0;
+    for(char *word = strtok(rest, " \t\n"); word != NULL; word = strtok(NULL, " \t\n")) {
+        char *end;
+        long f = strtol(word, &end, 10);
+        if(*end != '\0' || f < 1 || f >= AUDIO_FRAME_RATE / 2 || tp -> num_freqs == MAX_TONE_FREQS)
+            return -1;
+        for(int i = 0; i < tp -> num_freqs; i++) {
+            if(*(tp -> freqs + i) == f)
+                return -1;
+        }
+        *(tp -> freqs + tp -> num_freqs++) = f;
+        count++;
+    }
+    return count;
+}
+
+//helper function to find the index of a frequency in the table, or -1 if it is not there
+static int find_freq(const TONE_PROFILE *tp, long f) {
+    for(int i = 0; i < tp -> num_freqs; i++) {
+        if(*(tp -> freqs + i) == f)
+            return i;
+    }
+    return -1;
+}
+
+//helper function to read a profile file over the top of the DTMF profile
+static int read_profile(FILE *in, TONE_PROFILE *tp) {
+    char line[256];
+    int rows = -1, columns = -1, tones = -1, symbol_rows = 0, pairs = 0;
+    char words[MAX_TONE_FREQS][MAX_TONE_FREQS + 1];
+    while(fgets(line, sizeof(line), in) != NULL) {
+        char *comment = strchr(line, '#');
+        if(comment != NULL)
+            *comment = '\0';
+        char key[32];
+        int used;
+        if(sscanf(line, " %31s%n", key, &used) != 1)
+            continue;
+        char *rest = line + used;
+        double value;
+        if(strcmp(key, "rows") == 0 && rows < 0 && tones < 0 && tp -> num_freqs == 0) {
+            rows = read_freqs(rest, tp);
+            if(rows <= 0)
+                return -1;
+        } else if(strcmp(key, "columns") == 0 && rows > 0 && columns < 0) {
+            columns = read_freqs(rest, tp);
+            if(columns <= 0)
+                return -1;
+        } else if(strcmp(key, "symbols") == 0 && symbol_rows == 0) {
+            for(char *word = strtok(rest, " \t\n"); word != NULL; word = strtok(NULL, " \t\n")) {
+                if(symbol_rows == MAX_TONE_FREQS || strlen(word) > MAX_TONE_FREQS)
+                    return -1;
+                strcpy(*(words + symbol_rows++), word);
+            }
+        } else if(strcmp(key, "tones") == 0 && tones < 0 && rows < 0) {
+            tones = read_freqs(rest, tp);
+            if(tones < 2)
+                return -1;
+        } else if(strcmp(key, "pair") == 0 && tones > 0) {
+            long f1, f2;
+            char c;
+            if(sscanf(rest, "%ld %ld %c", &f1, &f2, &c) != 3)
+                return -1;
+            int a = find_freq(tp, f1), b = find_freq(tp, f2);
+            if(a < 0 || b < 0 || a == b)
+                return -1;
+            *(*(tp -> symbols + (a < b ? a : b)) + (a < b ? b : a)) = c;
+            pairs++;
+        } else if(sscanf(rest, "%lf", &value) == 1) {
+            if(strcmp(key, "twist") == 0 && value >= 0)
+                tp -> twist = from_db(value);
+            else if(strcmp(key, "separation") == 0 && value >= 0)
+                tp -> separation = from_db(value);
+            else if(strcmp(key, "min_level") == 0)
+                tp -> min_strength = from_db(value);
+            else if(strcmp(key, "min_duration") == 0 && value >= 0)
+                tp -> min_duration = value / 1000;
+            else
+                return -1;
+        } else {
+            return -1;
+        }
+    }
+    if(rows > 0) {
+        //a grid table needs its columns, and a symbol for every row and column
+        if(columns <= 0 || symbol_rows != rows)
+            return -1;
+        tp -> num_rows = rows;
+        for(int i = 0; i < rows; i++) {
+            if((int) strlen(*(words + i)) != columns)
+                return -1;
+            for(int j = 0; j < columns; j++) {
+                *(*(tp -> symbols + i) + rows + j) = *(*(words + i) + j);
+            }
+        }
+    } else if(tones > 0) {
+        if(pairs == 0 || symbol_rows != 0)
+            return -1;
+        tp -> num_rows = 0;
+    } else if(symbol_rows != 0) {
+        return -1;
+    } else {
+        //only thresholds were given, so the table is still DTMF
+        TONE_PROFILE thresholds = *tp;
+        *tp = dtmf_profile;
+        tp -> twist = thresholds.twist;
+        tp -> separation = thresholds.separation;
+        tp -> min_strength = thresholds.min_strength;
+        tp -> min_duration = thresholds.min_duration;
+    }
+    return 0;
+}
+
+int tone_profile_load(const char *name, TONE_PROFILE *tp) {
+    if(strcmp(name, "dtmf") == 0) {
+        *tp = dtmf_profile;
+        return 0;
+    }
+    if(strcmp(name, "mfr1") == 0) {
+        *tp = mfr1_profile;
+        return 0;
+    }
+    FILE *in = fopen(name, "r");
+    if(in == NULL)
+        return -1;
+    //the thresholds start out as those of DTMF; the table starts out empty
+    TONE_PROFILE profile = dtmf_profile;
+    profile.num_freqs = 0;
+    profile.num_rows = 0;
+    memset(profile.symbols, 0, sizeof(profile.symbols));
+    int ret = read_profile(in, &profile);
+    fclose(in);
+    if(ret == 0)
+        *tp = profile;
+    return ret;
+}
+
+int tone_profile_max_freq(const TONE_PROFILE *tp) {
+    int max = 0;
+    for(int i = 0; i < tp -> num_freqs; i++) {
+        if(*(tp -> freqs + i) > max)
+            max = *(tp -> freqs + i);
+    }
+    return max;
+}
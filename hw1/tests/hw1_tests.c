@@ -2,7 +2,19 @@
 #include <criterion/logging.h>
 #include <string.h>  // You may use this here in the test cases, but not elsewhere.
 #include <math.h>
+#include <unistd.h>
 #include "const.h"
+#include "audio_io.h"
+#include "goertzel_bank.h"
+#include "options.h"
+#include "buffers.h"
+#include "detect.h"
+#include "detector.h"
+#include "events.h"
+#include "tones.h"
+#include "telemetry.h"
+#include "decimate.h"
+#include "loopback.h"
 
 Test(basecode_tests_suite, validargs_help_test) {
     int argc = 2;
@@ -187,4 +199,768 @@ Test(basecode_tests_suite, goertzel_advanced_test) {
     cr_assert(r5, "r5 was %f, should be 0.031479", r5);
     cr_assert(r6, "r6 was %f, should be 0.000009", r6);
     cr_assert(r7, "r7 was %f, should be 0.000001", r7);
-}
\ No newline at end of file
+}
+Test(basecode_tests_suite, audio_read_samples_test) {
+    //block reads should give the same samples as reading one at a time
+    AUDIO_HEADER header;
+    FILE *fp1 = fopen("./rsrc/dtmf_0_500ms.au", "r");
+    FILE *fp2 = fopen("./rsrc/dtmf_0_500ms.au", "r");
+    audio_read_header(fp1, &header);
+    audio_read_header(fp2, &header);
+    int16_t block[300];
+    int n, total = 0;
+    while((n = audio_read_samples(fp1, block, 300)) > 0) {
+        for(int i = 0; i < n; i++) {
+            int16_t sample;
+            int ret = audio_read_sample(fp2, &sample);
+            cr_assert_eq(ret, 0, "Single sample read failed at sample %d", total + i);
+            cr_assert_eq(block[i], sample, "Sample %d was %d, should be %d", total + i, block[i], sample);
+        }
+        total += n;
+    }
+    cr_assert_eq(total, 4000, "Read %d samples, should be 4000", total);
+    fclose(fp1);
+    fclose(fp2);
+}
+
+Test(basecode_tests_suite, audio_map_file_test) {
+    //a mapped file should have the same header and samples as the stream
+    AUDIO_HEADER header, map_header;
+    AUDIO_MAP map;
+    FILE *fp1 = fopen("./rsrc/dtmf_0_500ms.au", "r");
+    FILE *fp2 = fopen("./rsrc/dtmf_0_500ms.au", "r");
+    int ret = audio_map_file(fp1, &map_header, &map);
+    cr_assert_eq(ret, 0, "Mapping a regular file failed. Got: %d | Expected: %d", ret, 0);
+    audio_read_header(fp2, &header);
+    cr_assert_eq(map_header.data_offset, header.data_offset, "Data offset was %u, should be %u",
+         map_header.data_offset, header.data_offset);
+    cr_assert_eq(map.num_samples, 4000, "Mapped %zu samples, should be 4000", map.num_samples);
+    for(int i = 0; i < 4000; i++) {
+        int16_t sample;
+        audio_read_sample(fp2, &sample);
+        int16_t mapped = (int16_t)((((uint8_t *)map.samples)[2*i] << 8) | ((uint8_t *)map.samples)[2*i+1]);
+        cr_assert_eq(mapped, sample, "Sample %d was %d, should be %d", i, mapped, sample);
+    }
+    audio_unmap_file(&map);
+    fclose(fp1);
+    fclose(fp2);
+}
+
+Test(basecode_tests_suite, audio_read_header_any_test) {
+    //only the permissive reader should take a header at some other rate and number of channels
+    AUDIO_HEADER header = { AUDIO_MAGIC, AUDIO_DATA_OFFSET, 0, PCM16_ENCODING, 16000, 2 };
+    FILE *fp = tmpfile();
+    audio_write_header(fp, &header);
+    rewind(fp);
+    int ret = audio_read_header(fp, &header);
+    cr_assert_eq(ret, EOF, "Strict read of a 16000 Hz stereo header. Got: %d | Expected: %d", ret, EOF);
+    rewind(fp);
+    ret = audio_read_header_any(fp, &header);
+    cr_assert_eq(ret, 0, "Permissive read of a 16000 Hz stereo header. Got: %d | Expected: %d", ret, 0);
+    cr_assert(header.sample_rate == 16000 && header.channels == 2, "Read %u Hz with %u channels",
+        header.sample_rate, header.channels);
+    fclose(fp);
+}
+
+Test(basecode_tests_suite, goertzel_bank_test) {
+    //the vectorized bank must agree with goertzel_step on every filter
+    AUDIO_HEADER header;
+    FILE *fp = fopen("./rsrc/dtmf_0_500ms.au", "r");
+    audio_read_header(fp, &header);
+    int16_t block[1000];
+    int N = audio_read_samples(fp, block, 1000);
+    int freqs[8] = { 697, 770, 852, 941, 1209, 1336, 1477, 1633 };
+    GOERTZEL_STATE scalar[8], banked[8];
+    for(int j = 0; j < 8; j++) {
+        goertzel_init(&scalar[j], N, (double) freqs[j] * N / 8000);
+        goertzel_init(&banked[j], N, (double) freqs[j] * N / 8000);
+    }
+    for(int i = 0; i < N-1; i++) {
+        for(int j = 0; j < 8; j++)
+            goertzel_step(&scalar[j], (double) block[i] / INT16_MAX);
+    }
+    GOERTZEL_BANK bank;
+    goertzel_bank_load(&bank, banked, 8);
+    goertzel_bank_run(&bank, block, N-1, 0);
+    goertzel_bank_store(&bank, banked);
+    double x = (double) block[N-1] / INT16_MAX;
+    for(int j = 0; j < 8; j++) {
+        double r1 = goertzel_strength(&scalar[j], x);
+        double r2 = goertzel_strength(&banked[j], x);
+        cr_assert(fabs(r1 - r2) <= 1e-12 * fabs(r1), "Filter %d was %.17g, should be %.17g", j, r2, r1);
+    }
+    fclose(fp);
+}
+
+Test(basecode_tests_suite, sliding_goertzel_test) {
+    //once the window has slid a whole block along, it should agree with the block filter
+    AUDIO_HEADER header;
+    FILE *fp = fopen("./rsrc/dtmf_0_500ms.au", "r");
+    audio_read_header(fp, &header);
+    int16_t block[1300];
+    audio_read_samples(fp, block, 1300);
+    int N = 1000;
+    double k = (double) 941 * N / 8000;
+    SLIDING_GOERTZEL_STATE sg;
+    sliding_goertzel_init(&sg, N, k);
+    for(int i = 0; i < 1300; i++) {
+        double x_old = i < N ? 0 : (double) block[i - N] / INT16_MAX;
+        sliding_goertzel_step(&sg, (double) block[i] / INT16_MAX, x_old);
+    }
+    GOERTZEL_STATE g;
+    goertzel_init(&g, N, k);
+    for(int i = 300; i < 1299; i++)
+        goertzel_step(&g, (double) block[i] / INT16_MAX);
+    double r1 = goertzel_strength(&g, (double) block[1299] / INT16_MAX);
+    double r2 = sliding_goertzel_strength(&sg);
+    cr_assert(fabs(r1 - r2) <= 1e-9 * fabs(r1), "Sliding strength was %f, should be %f", r2, r1);
+}
+
+Test(basecode_tests_suite, detect_parallel_test) {
+    //detection with several threads must write exactly the same events as with one
+    char out1[1024] = {0}, out4[1024] = {0};
+    block_size = 100;
+    hop_size = 0;
+    for(int t = 1; t <= 4; t += 3) {
+        FILE *in = fopen("./rsrc/dtmf_all.au", "r");
+        FILE *out = tmpfile();
+        num_threads = t;
+        int ret = dtmf_detect(in, out);
+        cr_assert_eq(ret, 0, "Detection with %d threads failed", t);
+        rewind(out);
+        size_t n = fread(t == 1 ? out1 : out4, 1, 1023, out);
+        cr_assert(n > 0, "No events detected with %d threads", t);
+        fclose(in);
+        fclose(out);
+    }
+    cr_assert_eq(strcmp(out1, out4), 0, "Events with 4 threads:\n%s\nshould be:\n%s", out4, out1);
+}
+
+Test(basecode_tests_suite, detect_realtime_test) {
+    //real-time events are the usual ones, each followed by its detection latency and each
+    //preceded by an onset line with "open" in place of the end
+    char out0[1024] = {0}, out1[1024] = {0};
+    block_size = 100;
+    hop_size = 0;
+    num_threads = 1;
+    for(int r = 0; r <= 1; r++) {
+        FILE *in = fopen("./rsrc/dtmf_all.au", "r");
+        FILE *out = tmpfile();
+        realtime = r;
+        int ret = dtmf_detect(in, out);
+        cr_assert_eq(ret, 0, "Detection with realtime = %d failed", r);
+        rewind(out);
+        size_t n = fread(r == 0 ? out0 : out1, 1, 1023, out);
+        cr_assert(n > 0, "No events detected with realtime = %d", r);
+        fclose(in);
+        fclose(out);
+    }
+    realtime = 0;
+    char *p0 = out0, *p1 = out1;
+    while(*p0 != '\0') {
+        size_t len = strcspn(p0, "\n");
+        long start, onset;
+        char symbol, onset_symbol;
+        int latency;
+        cr_assert_eq(sscanf(p0, "%ld\t%*d\t%c", &start, &symbol), 2, "Bad event %.*s", (int) len, p0);
+        cr_assert_eq(sscanf(p1, "%ld\topen\t%c\t%d\n", &onset, &onset_symbol, &latency), 3,
+            "Missing onset before %.*s", (int) len, p0);
+        cr_assert(onset == start && onset_symbol == symbol, "Onset %.*s does not match %.*s",
+            (int) strcspn(p1, "\n"), p1, (int) len, p0);
+        cr_assert(latency >= 0 && latency <= block_size, "Onset latency %d out of range", latency);
+        p1 += strcspn(p1, "\n") + 1;
+        cr_assert_eq(strncmp(p0, p1, len), 0, "Real-time event %.*s does not match %.*s",
+            (int) strcspn(p1, "\n"), p1, (int) len, p0);
+        p1 += len;
+        cr_assert_eq(sscanf(p1, "\t%d\n", &latency), 1, "Missing latency in real-time output");
+        cr_assert(latency >= 0 && latency <= block_size, "Latency %d out of range", latency);
+        p0 += len + 1;
+        p1 += strcspn(p1, "\n") + 1;
+    }
+    cr_assert_eq(*p1, '\0', "Extra real-time output: %s", p1);
+}
+
+Test(basecode_tests_suite, binary_events_test) {
+    //binary records must hold the same events as the text output, and generate the same audio
+    block_size = 100;
+    hop_size = 0;
+    num_threads = 1;
+    FILE *in = fopen("./rsrc/dtmf_all.au", "r");
+    FILE *text = tmpfile();
+    cr_assert_eq(dtmf_detect(in, text), 0, "Text detection failed");
+    fclose(in);
+    in = fopen("./rsrc/dtmf_all.au", "r");
+    FILE *binary = tmpfile();
+    binary_events = 1;
+    int ret = dtmf_detect(in, binary);
+    binary_events = 0;
+    cr_assert_eq(ret, 0, "Binary detection failed");
+    fclose(in);
+    rewind(text);
+    rewind(binary);
+    cr_assert_eq(events_read_header(binary), 0, "Bad binary events header");
+    EVENT_RECORD records[32];
+    int n = events_read_records(binary, records, 32);
+    cr_assert(n > 0 && n < 32, "Read %d records", n);
+    for(int i = 0; i < n; i++) {
+        long start, end;
+        char symbol;
+        cr_assert_eq(fscanf(text, "%ld\t%ld\t%c\n", &start, &end, &symbol), 3, "Too few text events");
+        cr_assert(records[i].start == start && records[i].end == end && records[i].symbol == symbol
+            && records[i].channel == -1, "Record %d does not match %ld\t%ld\t%c", i, start, end, symbol);
+        cr_assert(records[i].row_strength > MINUS_20DB / 2 && records[i].col_strength > MINUS_20DB / 2,
+            "Record %d has strengths %f, %f", i, records[i].row_strength, records[i].col_strength);
+    }
+    cr_assert_eq(fgetc(text), EOF, "Too few binary events");
+    //generating from either form must give the same samples
+    char *audio[2];
+    size_t size[2];
+    for(int b = 0; b <= 1; b++) {
+        FILE *events = b ? binary : text;
+        rewind(events);
+        FILE *out = open_memstream(&audio[b], &size[b]);
+        noise_file = NULL;
+        binary_events = b;
+        ret = dtmf_generate(events, out, 80000);
+        binary_events = 0;
+        cr_assert_eq(ret, 0, "Generation with binary_events = %d failed", b);
+        fclose(out);
+    }
+    cr_assert(size[0] == size[1] && memcmp(audio[0], audio[1], size[0]) == 0,
+        "Audio generated from binary events differs");
+    free(audio[0]);
+    free(audio[1]);
+    fclose(text);
+    fclose(binary);
+}
+
+Test(basecode_tests_suite, telemetry_test) {
+    //there must be a line for every block, and the verdict counts must add up to the number of blocks
+    block_size = 100;
+    hop_size = 0;
+    num_threads = 1;
+    char path[] = "/tmp/hw1_telemetry_XXXXXX";
+    close(mkstemp(path));
+    FILE *in = fopen("./rsrc/dtmf_all.au", "r");
+    FILE *out = tmpfile();
+    telemetry_file = path;
+    int ret = dtmf_detect(in, out);
+    telemetry_file = NULL;
+    cr_assert_eq(ret, 0, "Detection with telemetry failed");
+    fclose(in);
+    fclose(out);
+    FILE *tel = fopen(path, "r");
+    char line[512];
+    long blocks = 0, tones = 0, counted = 0, count;
+    char verdict[16];
+    while(fgets(line, sizeof(line), tel) != NULL) {
+        if(line[0] != '#') {
+            blocks++;
+            char *last = strrchr(line, '\t');
+            tones += (last[2] == '\n');
+        } else if(sscanf(line, "#%15[a-z]\t%ld", verdict, &count) == 2) {
+            counted += count;
+            if(strcmp(verdict, "tone") == 0)
+                cr_assert_eq(count, tones, "Counted %ld tones, but there are %ld tone lines", count, tones);
+        }
+    }
+    fclose(tel);
+    unlink(path);
+    cr_assert_eq(blocks, 129, "There were %ld block lines, should be 129", blocks);
+    cr_assert_eq(counted, blocks, "Verdict counts add up to %ld, should be %ld", counted, blocks);
+}
+
+Test(basecode_tests_suite, generate_table_test) {
+    //table-driven synthesis must be within 1 LSB of evaluating cos() at every sample
+    char events[] = "0\t1000\t1\n1000\t3000\t5\n3500\t70001\tD\n";
+    FILE *in = fmemopen(events, strlen(events), "r");
+    FILE *out = tmpfile();
+    noise_file = NULL;
+    int ret = dtmf_generate(in, out, 80000);
+    cr_assert_eq(ret, 0, "Generation failed");
+    rewind(out);
+    AUDIO_HEADER header;
+    audio_read_header(out, &header);
+    int fr[] = {697, 770, 941}, fc[] = {1209, 1336, 1633};
+    int s[] = {0, 1000, 3500}, e[] = {1000, 3000, 70001};
+    int ev = 0;
+    for(int i = 0; i < 80000; i++) {
+        int16_t sample;
+        cr_assert_eq(audio_read_sample(out, &sample), 0, "Missing sample %d", i);
+        double x = 0;
+        if(ev < 3 && i >= e[ev])
+            ev++;
+        if(ev < 3 && i >= s[ev])
+            x = (cos(2.0 * M_PI * fr[ev] * i / AUDIO_FRAME_RATE) * 0.5 +
+                cos(2.0 * M_PI * fc[ev] * i / AUDIO_FRAME_RATE) * 0.5) * INT16_MAX;
+        int16_t expected = (int16_t) x;
+        cr_assert(abs(sample - expected) <= 1, "Sample %d was %d, should be %d", i, sample, expected);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+void mix_noise(int16_t *out, const double *tone, const int16_t *noise, int count, double w);
+
+Test(basecode_tests_suite, mix_noise_test) {
+    //mixing must saturate rather than wrap around, for every sample whatever the count
+    double tone[11];
+    int16_t noise[11], out[11];
+    for(int i = 0; i < 11; i++) {
+        tone[i] = (i % 2 ? -1 : 1) * (30000.0 + 1000 * i);
+        noise[i] = (int16_t) (i % 2 ? INT16_MIN : INT16_MAX);
+    }
+    for(int count = 1; count <= 11; count++) {
+        mix_noise(out, tone, noise, count, 0.25);
+        for(int i = 0; i < count; i++) {
+            double x = noise[i] * 0.25 + tone[i] * 0.75;
+            int16_t expected = x > INT16_MAX ? INT16_MAX : x < INT16_MIN ? INT16_MIN : (int16_t) x;
+            cr_assert_eq(out[i], expected, "Sample %d of %d was %d, should be %d", i, count, out[i], expected);
+        }
+    }
+}
+
+Test(basecode_tests_suite, detect_stereo_test) {
+    //a stereo file with silence on channel 0 and dtmf_all.au on channel 1 must give
+    //the events for dtmf_all.au, all on channel 1
+    char mono[1024] = {0}, stereo[1024] = {0};
+    block_size = 100;
+    hop_size = 0;
+    num_threads = 1;
+    FILE *in = fopen("./rsrc/dtmf_all.au", "r");
+    FILE *out = tmpfile();
+    cr_assert_eq(dtmf_detect(in, out), 0, "Monaural detection failed");
+    rewind(out);
+    fread(mono, 1, 1023, out);
+    fclose(out);
+    rewind(in);
+    AUDIO_HEADER header;
+    audio_read_header(in, &header);
+    header.channels = 2;
+    FILE *st = tmpfile();
+    audio_write_header(st, &header);
+    int16_t sample;
+    while(audio_read_sample(in, &sample) == 0) {
+        audio_write_sample(st, 0);
+        audio_write_sample(st, sample);
+    }
+    fclose(in);
+    rewind(st);
+    out = tmpfile();
+    cr_assert_eq(dtmf_detect(st, out), 0, "Stereo detection failed");
+    rewind(out);
+    fread(stereo, 1, 1023, out);
+    fclose(out);
+    fclose(st);
+    char *p = mono, *q = stereo;
+    while(*p != '\0') {
+        size_t len = strcspn(p, "\n") + 1;
+        cr_assert_eq(strncmp(q, "1\t", 2), 0, "Stereo event not on channel 1: %s", q);
+        cr_assert_eq(strncmp(p, q + 2, len), 0, "Stereo event %.*s should be %.*s",
+            (int) strcspn(q, "\n"), q, (int) len - 1, p);
+        p += len;
+        q += len + 2;
+    }
+    cr_assert_eq(*q, '\0', "Extra stereo events: %s", q);
+}
+
+Test(basecode_tests_suite, detect_rate_test) {
+    //-b counts samples at 8000 Hz, so dtmf_all.au at twice the rate (each sample repeated) must
+    //give the same events, with every index doubled; a block of under 10 samples must be refused
+    char slow[1024] = {0}, fast[1024] = {0};
+    block_size = 100;
+    hop_size = 0;
+    num_threads = 1;
+    FILE *in = fopen("./rsrc/dtmf_all.au", "r");
+    FILE *out = tmpfile();
+    cr_assert_eq(dtmf_detect(in, out), 0, "Detection at 8000 Hz failed");
+    rewind(out);
+    fread(slow, 1, 1023, out);
+    fclose(out);
+    rewind(in);
+    AUDIO_HEADER header;
+    audio_read_header(in, &header);
+    header.sample_rate = 16000;
+    FILE *up = tmpfile();
+    audio_write_header(up, &header);
+    int16_t sample;
+    while(audio_read_sample(in, &sample) == 0) {
+        audio_write_sample(up, sample);
+        audio_write_sample(up, sample);
+    }
+    fclose(in);
+    rewind(up);
+    out = tmpfile();
+    cr_assert_eq(dtmf_detect(up, out), 0, "Detection at 16000 Hz failed");
+    rewind(out);
+    fread(fast, 1, 1023, out);
+    fclose(out);
+    fclose(up);
+    char *p = slow, *q = fast;
+    long s1, e1, s2, e2;
+    char c1, c2;
+    int n1, n2;
+    while(sscanf(p, "%ld\t%ld\t%c\n%n", &s1, &e1, &c1, &n1) == 3) {
+        cr_assert_eq(sscanf(q, "%ld\t%ld\t%c\n%n", &s2, &e2, &c2, &n2), 3, "Missing event at 16000 Hz");
+        cr_assert(s2 == 2 * s1 && e2 == 2 * e1 && c2 == c1, "Event %.*s at 16000 Hz should be %ld\t%ld\t%c",
+            n2 - 1, q, 2 * s1, 2 * e1, c1);
+        p += n1;
+        q += n2;
+    }
+    cr_assert_eq(*q, '\0', "Extra events at 16000 Hz: %s", q);
+    cr_assert_eq(block_frames(10, 4000), 5, "Wrong scaled block size");
+    block_size = 10;
+    header.sample_rate = 4000;
+    header.data_offset = AUDIO_DATA_OFFSET;
+    FILE *down = tmpfile();
+    audio_write_header(down, &header);
+    for(int i = 0; i < 4000; i++)
+        audio_write_sample(down, 0);
+    rewind(down);
+    cr_assert_eq(dtmf_detect(down, stdout), EOF, "Blocks of 5 samples not refused");
+    fclose(down);
+    block_size = 100;
+}
+
+Test(basecode_tests_suite, decimator_test) {
+    //a DTMF-band tone must come through decimation at full strength, while a tone
+    //that would alias onto the same frequency must be all but removed
+    cr_assert_eq(decimate_factor(48000, 600), 6, "Wrong factor for 48000 Hz, 600 samples");
+    cr_assert_eq(decimate_factor(44100, 1000), 5, "Wrong factor for 44100 Hz, 1000 samples");
+    cr_assert_eq(decimate_factor(8000, 100), 1, "Wrong factor for 8000 Hz, 100 samples");
+    static DECIMATOR dec;
+    int16_t in[600], out[100];
+    for(int f = 1000; f <= 7000; f += 6000) {
+        decimator_init(&dec, 48000, 6);
+        double peak = 0;
+        for(int b = 0; b < 10; b++) {
+            for(int i = 0; i < 600; i++)
+                in[i] = (int16_t) (10000 * sin(2 * M_PI * f * (b * 600 + i) / 48000.0));
+            decimator_run(&dec, in, 600, 0, out);
+            //skip the first block, while the filter fills up
+            for(int i = 0; b > 0 && i < 100; i++)
+                peak = fabs(out[i]) > peak ? fabs(out[i]) : peak;
+        }
+        if(f == 1000)
+            cr_assert(peak > 9900 && peak < 10100, "Passband tone peak %f, should be about 10000", peak);
+        else
+            cr_assert(peak < 100, "Aliasing tone peak %f, should be under 100", peak);
+    }
+}
+
+Test(basecode_tests_suite, fixed_point_test) {
+    //the fixed-point bank must make the same decision as the double-precision bank on every block
+    char *files[] = { "./rsrc/dtmf_all.au", "./rsrc/dtmf_0_500ms.au", "./rsrc/941Hz_1sec.au",
+        "./rsrc/white_noise_10s.au" };
+    int sizes[] = { 10, 37, 100, 250, 1000 };
+    static int16_t samples[80000];
+    GOERTZEL_STATE dstates[8], fstates[8];
+    double strengths[8];
+    DETECT_OPTIONS doptions = { &tone_profile, 0, 0, 0 }, foptions = { &tone_profile, 1, 0, 0 };
+    for(int f = 0; f < 4; f++) {
+        AUDIO_HEADER header;
+        FILE *fp = fopen(files[f], "r");
+        audio_read_header(fp, &header);
+        int n = audio_read_samples(fp, samples, 80000);
+        fclose(fp);
+        for(int s = 0; s < 5; s++) {
+            int N = sizes[s];
+            dstates[0].N = fstates[0].N = 0;
+            for(int b = 0; b + N <= n; b += N) {
+                DTMF_DECISION d, fd;
+                decide_block(samples + b, N, 8000, 0, dstates, strengths, &doptions, &d);
+                decide_block(samples + b, N, 8000, 0, fstates, strengths, &foptions, &fd);
+                //the strongest row and column only mean anything if a tone was found
+                cr_assert(d.tone == fd.tone && (d.tone != 0 || (d.str_row_index == fd.str_row_index &&
+                    d.str_col_index == fd.str_col_index)), "%s, N = %d: block at %d decided differently",
+                    files[f], N, b);
+            }
+        }
+    }
+    //a full-scale square wave at a frequency just inside the load guard drives the state about as
+    //far as it can go, to nearly 2^30, where the product c * s1 is nearly 2^31; it must still agree
+    int N = 1000;
+    GOERTZEL_STATE dg, fg;
+    goertzel_init(&dg, N, 26.0 * N / 8000);
+    goertzel_init(&fg, N, 26.0 * N / 8000);
+    for(int i = 0; i < N; i++)
+        samples[i] = sin(dg.A * (N - 1 - i)) >= 0 ? INT16_MAX : -INT16_MAX;
+    GOERTZEL_BANK bank;
+    goertzel_bank_load(&bank, &dg, 1);
+    goertzel_bank_run(&bank, samples, N - 1, 0);
+    goertzel_bank_store(&bank, &dg);
+    GOERTZEL_FIXED_BANK fixed_bank;
+    cr_assert_eq(goertzel_fixed_bank_load(&fixed_bank, &fg, 1), 0, "Filter at 26 Hz refused");
+    goertzel_fixed_bank_run(&fixed_bank, samples, N - 1, 0);
+    goertzel_fixed_bank_store(&fixed_bank, &fg);
+    cr_assert(fabs(dg.s1) * INT16_MAX > 0.9 * (1 << 30) && fabs(fg.s1 - dg.s1) < 1e-5 * fabs(dg.s1),
+        "Fixed-point state %f should be %f", fg.s1, dg.s1);
+    double x = (double) samples[N - 1] / INT16_MAX;
+    double r1 = goertzel_strength(&dg, x), r2 = goertzel_strength(&fg, x);
+    cr_assert(fabs(r1 - r2) < 1e-4 * r1, "Fixed-point strength %f should be %f", r2, r1);
+}
+
+Test(basecode_tests_suite, tone_profile_test) {
+    //MF R1 pairs generated with the mfr1 profile must be detected with it, and not as DTMF
+    const char *events = "0\t800\tK\n1200\t1600\t1\n2000\t2400\t5\n2800\t3200\t0\n3600\t4000\tS\n";
+    block_size = 100;
+    hop_size = 0;
+    num_threads = 1;
+    noise_file = NULL;
+    cr_assert_eq(tone_profile_load("mfr1", &tone_profile), 0, "Unable to load the mfr1 profile");
+    cr_assert_eq(tone_profile_max_freq(&tone_profile), 1700, "Wrong highest MF R1 frequency");
+    FILE *in = fmemopen((char *) events, strlen(events), "r");
+    char *audio;
+    size_t size;
+    FILE *out = open_memstream(&audio, &size);
+    cr_assert_eq(dtmf_generate(in, out, 8000), 0, "MF R1 generation failed");
+    fclose(in);
+    fclose(out);
+    char *found;
+    size_t found_size;
+    for(int p = 0; p <= 1; p++) {
+        cr_assert_eq(tone_profile_load(p ? "dtmf" : "mfr1", &tone_profile), 0, "Unable to load a profile");
+        in = fmemopen(audio, size, "r");
+        out = open_memstream(&found, &found_size);
+        int ret = dtmf_detect(in, out);
+        fclose(in);
+        fclose(out);
+        cr_assert_eq(ret, 0, "Detection failed with profile %d", p);
+        if(p == 0)
+            cr_assert(found_size == strlen(events) && memcmp(found, events, found_size) == 0,
+                "MF R1 events detected as:\n%.*s", (int) found_size, found);
+        else
+            cr_assert_eq(found_size, 0, "MF R1 tones detected as DTMF:\n%.*s", (int) found_size, found);
+        free(found);
+    }
+    free(audio);
+    cr_assert_neq(tone_profile_load("./rsrc/no_such_profile", &tone_profile), 0, "Loaded a missing profile");
+}
+
+Test(basecode_tests_suite, loopback_test) {
+    //generating and detecting in one process must give the same events as doing it in two steps
+    const char *events = "0\t800\t1\n1000\t2600\t#\n3000\t3400\tD\n5000\t7999\t5\n";
+    block_size = 100;
+    hop_size = 0;
+    num_threads = 1;
+    noise_file = NULL;
+    FILE *in = fmemopen((char *) events, strlen(events), "r");
+    char *audio;
+    size_t size;
+    FILE *out = open_memstream(&audio, &size);
+    cr_assert_eq(dtmf_generate(in, out, 8000), 0, "Generation failed");
+    fclose(in);
+    fclose(out);
+    char *expected, *found;
+    size_t expected_size, found_size;
+    in = fmemopen(audio, size, "r");
+    out = open_memstream(&expected, &expected_size);
+    cr_assert_eq(dtmf_detect(in, out), 0, "Detection failed");
+    fclose(in);
+    fclose(out);
+    in = fmemopen((char *) events, strlen(events), "r");
+    out = open_memstream(&found, &found_size);
+    cr_assert_eq(dtmf_loopback(in, out, 8000), 0, "Loopback failed");
+    fclose(in);
+    fclose(out);
+    cr_assert(found_size == expected_size && memcmp(found, expected, found_size) == 0,
+        "Loopback events:\n%.*s", (int) found_size, found);
+    free(audio);
+    free(expected);
+    free(found);
+}
+
+Test(basecode_tests_suite, block_energy_test) {
+    //the energy must be exact, in either byte order, even for full-scale samples
+    static int16_t samples[1003], swapped[1003];
+    uint64_t expected = 0;
+    for(int i = 0; i < 1003; i++) {
+        samples[i] = i % 7 == 0 ? INT16_MIN : (int16_t) (i * 7919);
+        swapped[i] = (int16_t) __builtin_bswap16(samples[i]);
+        expected += (uint64_t) ((int32_t) samples[i] * samples[i]);
+    }
+    cr_assert_eq(goertzel_block_energy(samples, 1003, 0), expected, "Wrong energy");
+    cr_assert_eq(goertzel_block_energy(swapped, 1003, 1), expected, "Wrong big-endian energy");
+    //blocks passed over as quiet must be ones the filters would have found too weak
+    FILE *fp = fopen("./rsrc/dtmf_0_500ms.au", "r");
+    AUDIO_HEADER header;
+    audio_read_header(fp, &header);
+    int n = audio_read_samples(fp, samples, 1000);
+    fclose(fp);
+    GOERTZEL_STATE states[8];
+    double strengths[8];
+    DETECT_OPTIONS options = { &tone_profile, 0, 0, 0 }, all_options = { &tone_profile, 0, 1, 0 };
+    states[0].N = 0;
+    for(int scale = 1; scale <= 64; scale *= 2) {
+        for(int i = 0; i < n; i++) {
+            swapped[i] = samples[i] / scale;
+        }
+        DTMF_DECISION d;
+        decide_block(swapped, 100, 8000, 0, states, strengths, &options, &d);
+        DTMF_DECISION full;
+        decide_block(swapped, 100, 8000, 0, states, strengths, &all_options, &full);
+        cr_assert_eq(d.tone, full.tone, "Scale 1/%d decided differently", scale);
+    }
+}
+
+//callback for detector_test: appends each event to the stream given, as dtmf -d would write it
+static void write_record(void *arg, const EVENT_RECORD *rp) {
+    if(rp -> channel >= 0)
+        fprintf(arg, "%d\t", rp -> channel);
+    fprintf(arg, "%ld\t%ld\t%c\n", (long) rp -> start, (long) rp -> end, rp -> symbol);
+}
+
+Test(basecode_tests_suite, detector_test) {
+    //detectors fed in ragged chunks must find the same events as dtmf_detect, even when
+    //two of them (one monaural, one stereo) are interleaved
+    block_size = 100;
+    hop_size = 0;
+    num_threads = 1;
+    FILE *in = fopen("./rsrc/dtmf_all.au", "r");
+    char *expected;
+    size_t expected_size;
+    FILE *out = open_memstream(&expected, &expected_size);
+    cr_assert_eq(dtmf_detect(in, out), 0, "Detection failed");
+    fclose(out);
+    rewind(in);
+    AUDIO_HEADER header;
+    audio_read_header(in, &header);
+    static int16_t samples[80000], stereo[160000];
+    int n = audio_read_samples(in, samples, 80000);
+    fclose(in);
+    for(int i = 0; i < n; i++) {
+        stereo[2 * i] = 0;
+        stereo[2 * i + 1] = samples[i];
+    }
+    DTMF_DETECTOR mono_detector, stereo_detector;
+    DETECT_OPTIONS options = { &tone_profile, 0, 0, 0 };
+    char *found[2];
+    size_t found_size[2];
+    FILE *found_out[2];
+    found_out[0] = open_memstream(&found[0], &found_size[0]);
+    found_out[1] = open_memstream(&found[1], &found_size[1]);
+    cr_assert_eq(dtmf_detector_init(&mono_detector, 8000, 1, 100, &options, write_record, found_out[0]), 0, "Init failed");
+    cr_assert_eq(dtmf_detector_init(&stereo_detector, 8000, 2, 100, &options, write_record, found_out[1]), 0, "Init failed");
+    for(int i = 0, chunk = 1; i < n; i += chunk, chunk = chunk * 7 % 1013) {
+        int count = i + chunk <= n ? chunk : n - i;
+        cr_assert_eq(dtmf_detector_push(&mono_detector, samples + i, count), 0, "Push failed");
+        //odd chunks of stereo samples end in the middle of a frame
+        cr_assert_eq(dtmf_detector_push(&stereo_detector, stereo + 2 * i, count), 0, "Push failed");
+        cr_assert_eq(dtmf_detector_push(&stereo_detector, stereo + 2 * i + count, count), 0, "Push failed");
+    }
+    cr_assert_eq(dtmf_detector_finish(&mono_detector), 0, "Finish failed");
+    cr_assert_eq(dtmf_detector_finish(&stereo_detector), 0, "Finish failed");
+    cr_assert_neq(dtmf_detector_push(&mono_detector, samples, 1), 0, "Pushed after finish");
+    dtmf_detector_destroy(&mono_detector);
+    dtmf_detector_destroy(&stereo_detector);
+    fclose(found_out[0]);
+    fclose(found_out[1]);
+    cr_assert(found_size[0] == expected_size && memcmp(found[0], expected, expected_size) == 0,
+        "Detector events:\n%.*s", (int) found_size[0], found[0]);
+    char *p = expected, *q = found[1];
+    while(*p != '\0') {
+        size_t len = strcspn(p, "\n") + 1;
+        cr_assert(strncmp(q, "1\t", 2) == 0 && strncmp(p, q + 2, len) == 0, "Stereo detector event %.*s",
+            (int) strcspn(q, "\n"), q);
+        p += len;
+        q += len + 2;
+    }
+    cr_assert_eq(*q, '\0', "Extra stereo detector events: %s", q);
+    free(expected);
+    free(found[0]);
+    free(found[1]);
+    cr_assert_eq(dtmf_detector_init(&mono_detector, 3000, 1, 100, &options, write_record, NULL), -1,
+        "Accepted a rate too low for the tones");
+}
+
+Test(basecode_tests_suite, generate_sparse_test) {
+    //long lines must be read whole, and long gaps skipped over in a regular file must read back
+    //as the same zeroes that are written out to a stream
+    char events[512];
+    int len = sprintf(events, "%0100d\t800\t1\t%0200d\n\n30000\t31000\t#\n", 0, 0);
+    noise_file = NULL;
+    char *audio[2];
+    size_t size[2];
+    for(int f = 0; f <= 1; f++) {
+        FILE *in = fmemopen(events, len, "r");
+        FILE *out = f ? tmpfile() : open_memstream(&audio[f], &size[f]);
+        cr_assert_eq(dtmf_generate(in, out, 80000), 0, "Generation %d failed", f);
+        fclose(in);
+        if(f) {
+            size[f] = ftell(out);
+            audio[f] = malloc(size[f]);
+            rewind(out);
+            cr_assert_eq(fread(audio[f], 1, size[f], out), size[f], "Short file");
+        }
+        fclose(out);
+    }
+    cr_assert_eq(size[0], 24 + 80000 * 2, "Wrong size %zu", size[0]);
+    cr_assert(size[0] == size[1] && memcmp(audio[0], audio[1], size[0]) == 0, "Sparse file differs");
+    int16_t *samples = (int16_t *) (audio[1] + 24);
+    for(int i = 31000; i < 80000; i++) {
+        cr_assert_eq(samples[i], 0, "Sample %d is not silent", i);
+    }
+    cr_assert_neq(samples[100], 0, "Tone missing");
+    free(audio[0]);
+    free(audio[1]);
+}
+
+Test(basecode_tests_suite, coarse_test) {
+    //two-pass detection must find every event, with its boundaries within half a block of where
+    //the tones really start and end
+    block_size = 205;
+    hop_size = 0;
+    num_threads = 1;
+    coarse_factor = 4;
+    FILE *in = fopen("./rsrc/dtmf_all.au", "r");
+    FILE *out = tmpfile();
+    int ret = dtmf_detect(in, out);
+    coarse_factor = 0;
+    cr_assert_eq(ret, 0, "Two-pass detection failed");
+    fclose(in);
+    rewind(out);
+    FILE *ref = fopen("./rsrc/dtmf_all.txt", "r");
+    long start, end, ref_start, ref_end;
+    char symbol, ref_symbol;
+    int events = 0;
+    while(fscanf(ref, "%ld %ld %c", &ref_start, &ref_end, &ref_symbol) == 3) {
+        cr_assert_eq(fscanf(out, "%ld %ld %c", &start, &end, &symbol), 3, "Event %d missing", events);
+        cr_assert_eq(symbol, ref_symbol, "Event %d has the wrong symbol", events);
+        cr_assert(labs(start - ref_start) <= block_size / 2 && labs(end - ref_end) <= block_size / 2,
+            "Event %d at %ld-%ld, not %ld-%ld", events, start, end, ref_start, ref_end);
+        events++;
+    }
+    cr_assert_eq(fscanf(out, "%ld %ld %c", &start, &end, &symbol), EOF, "Extra events");
+    fclose(ref);
+    fclose(out);
+}
+
+//thread function for goertzel_cache_test: look up the DTMF filters for 100-sample blocks
+static void *cache_lookup_thread(void *arg) {
+    int freqs[] = { 697, 770, 852, 941, 1209, 1336, 1477, 1633 };
+    return (void *) goertzel_cache_lookup(8000, 100, freqs, 8);
+}
+
+Test(basecode_tests_suite, goertzel_cache_test) {
+    //each table must be worked out exactly as goertzel_init would, once, and shared by every thread
+    int freqs[] = { 697, 770, 852, 941, 1209, 1336, 1477, 1633 };
+    pthread_t threads[4];
+    for(int t = 0; t < 4; t++) {
+        pthread_create(&threads[t], NULL, cache_lookup_thread, NULL);
+    }
+    const GOERTZEL_STATE *found[4];
+    for(int t = 0; t < 4; t++) {
+        pthread_join(threads[t], (void **) &found[t]);
+        cr_assert(found[t] != NULL && found[t] == found[0], "Thread %d got other filters", t);
+    }
+    cr_assert_eq(goertzel_cache_lookup(8000, 100, freqs, 8), found[0], "Lookup not cached");
+    cr_assert_neq(goertzel_cache_lookup(8000, 205, freqs, 8), found[0], "Block size ignored");
+    cr_assert_neq(goertzel_cache_lookup(16000, 100, freqs, 8), found[0], "Rate ignored");
+    cr_assert_neq(goertzel_cache_lookup(8000, 100, freqs, 7), found[0], "Table ignored");
+    for(int i = 0; i < 8; i++) {
+        GOERTZEL_STATE g;
+        goertzel_init(&g, 100, freqs[i] * 100.0 / 8000);
+        cr_assert(found[0][i].N == g.N && found[0][i].k == g.k && found[0][i].B == g.B
+            && found[0][i].A == g.A && found[0][i].s1 == 0, "Filter %d differs", i);
+    }
+}
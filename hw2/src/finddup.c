@@ -9,13 +9,15 @@
 |  or any derivative program may not be restricted.
 |----------------------------------------------------------------
 |  Calling sequence:
-|   finddup [-l] checklist
+|   finddup [-l] [-j jobs] checklist
 |
 |  where checklist is the name of a file containing filenames to
 |  be checked, such as produced by "find . -type f -print >file"
 |  returns a list of linked and duplicated files.
 |
 |  If the -l option is used the hard links will not be displayed.
+|  The -j option sets how many files are read for their CRC at
+|  once (default one per CPU).
 \***************************************************************/
 
 #include <stdio.h>
@@ -26,6 +28,10 @@
 #include <string.h>
 #include <stdint.h>
 #include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
 #include "crc32.h"
 
 /* constants */
@@ -33,14 +39,15 @@
 #define FL_CRC	0x0001			/* flag if CRC valid */
 #define FL_DUP	0x0002			/* files are duplicates */
 #define FL_LNK	0x0004			/* file is a link */
+#define CRC_BUFSIZE	(1024*1024)	/* bytes read at a time for a CRC */
 
 /* macros */
 #ifdef DEBUG
 #define debug(X) if (DebugFlg) printf X
-#define OPTSTR	"lhd::"
+#define OPTSTR	"lhj:d::"
 #else
 #define debug(X)
-#define OPTSTR	"lh"
+#define OPTSTR	"lhj:"
 #endif
 #define SORT qsort((char *)filelist, n_files, sizeof(filedesc), comp1);
 #define GetFlag(x,f) ((filelist[x].flags & (f)) != 0)
@@ -59,6 +66,7 @@ filedesc *filelist;				/* master sorted list of files */
 long n_files = 0;				/* # files in the array */
 long max_files = 0;				/* entries allocated in the array */
 int linkflag = 1;				/* show links */
+int n_jobs = 0;					/* CRC threads, 0 for one per CPU */
 int DebugFlg = 0;				/* inline debug flag */
 FILE *namefd;					/* file for names */
 
@@ -73,6 +81,7 @@ static char *HelpMsg[] = {
 	"",
 	"Options:",
 	"  -l - don't list hard links",
+	"  -j n - read n files at once for the CRC (default one per CPU)",
 #ifdef DEBUG
 	"  -d - debug (must compile with DEBUG)"
 #endif /* ?DEBUG */
@@ -90,6 +99,7 @@ static int comp1();				/* compare two filedesc's */
 static void scan1();			/* make the CRC scan */
 static void scan2();			/* do full compare if needed */
 static void scan3();			/* print the results */
+static void *crc_worker();		/* get crc32's off the work list */
 static uint32_t get_crc();		/* get crc32 on a file */
 static char *getfn();			/* get a filename by index */
 static int fullcmp();			/* full compare two filedesc's */
@@ -115,6 +125,7 @@ char *argv[];
 	static struct option long_options[] = {
 		{"help", no_argument, NULL, 'h'},
 	    {"no-links", no_argument, NULL, 'l'},
+	    {"jobs", required_argument, NULL, 'j'},
 #ifdef DEBUG
 	    {"debug", optional_argument, NULL, 'd'},
 #endif
@@ -126,6 +137,17 @@ char *argv[];
 			case 'l': /* set link flag */
 				linkflag = 0;
 				break;
+			case 'j': /* number of CRC threads */
+				{
+					int num, chars_passed;
+					int value = sscanf(optarg, "%d%n", &num, &chars_passed);
+					if(value != 1 || strlen(optarg) != chars_passed || num <= 0) {
+						printf("Number of jobs %s is not a valid positive integer\n", optarg);
+						exit(exitflag);
+					}
+					n_jobs = num;
+				}
+				break;
 #ifdef DEBUG
 			case 'd': /* debug */
 				if(optarg) {
@@ -285,28 +307,103 @@ char *p1, *p2;
 
 /* scan1 - get a CRC32 for files of equal length */
 
+/* work list for the CRC threads, shared under crc_lock */
+static int *crc_work;			/* indexes of the files to CRC */
+static int crc_count;			/* # entries in the work list */
+static int crc_next;			/* next entry to be taken */
+static pthread_mutex_t crc_lock = PTHREAD_MUTEX_INITIALIZER;
+
 void
 scan1() {
 	int ix, needsort = 0;
+	long n_threads, tx;
+	pthread_t *threads;
 
+	/* list the files which need a CRC */
+	crc_work = (int *) malloc((n_files + 1) * sizeof(int));
+	if (crc_work == NULL) {
+		perror("Out of memory!");
+		exit(1);
+	}
+	crc_count = crc_next = 0;
 	for (ix = 1; ix < n_files; ++ix) {
 		if (filelist[ix-1].length == filelist[ix].length) {
 			/* get a CRC for each */
 			if (! GetFlag(ix-1, FL_CRC)) {
-				filelist[ix-1].crc32 = get_crc(ix-1);
+				crc_work[crc_count++] = ix-1;
 				SetFlag(ix-1, FL_CRC);
 			}
 			if (! GetFlag(ix, FL_CRC)) {
-				filelist[ix].crc32 = get_crc(ix);
+				crc_work[crc_count++] = ix;
 				SetFlag(ix, FL_CRC);
 			}
 			needsort = 1;
 		}
 	}
 
+	/*
+	 * Reading the files is most of the run time, so it is shared out
+	 * over a pool of threads, this one included.  rc_crc32 builds its
+	 * table on first use without any lock, so build it here before
+	 * any of them start.
+	 */
+	rc_crc32(0, "", 0);
+	n_threads = n_jobs > 0 ? n_jobs : sysconf(_SC_NPROCESSORS_ONLN);
+	if (n_threads > crc_count) n_threads = crc_count;
+	if (n_threads < 1) n_threads = 1;
+	threads = (pthread_t *) malloc(n_threads * sizeof(pthread_t));
+	if (threads == NULL) {
+		perror("Out of memory!");
+		exit(1);
+	}
+	for (tx = 1; tx < n_threads; ++tx) {
+		/* if a thread can't be had, the rest just do more */
+		if (pthread_create(&threads[tx], NULL, crc_worker, NULL) != 0) break;
+	}
+	crc_worker(NULL);
+	while (--tx > 0) {
+		pthread_join(threads[tx], NULL);
+	}
+	free(threads);
+	free(crc_work);
+
 	if (needsort) SORT;
 }
-
+
+/* crc_worker - CRC files off the work list until it is empty */
+
+void *
+crc_worker(arg)
+void *arg;
+{
+	int ix;
+	char *fname;
+	char *buf;
+
+	/* each thread reads its files through its own buffer */
+	buf = (char *) malloc(CRC_BUFSIZE);
+	if (buf == NULL) {
+		perror("Out of memory!");
+		exit(1);
+	}
+	for (;;) {
+		/* the names file is shared too, so read the name under the lock */
+		pthread_mutex_lock(&crc_lock);
+		if (crc_next == crc_count) {
+			pthread_mutex_unlock(&crc_lock);
+			break;
+		}
+		ix = crc_work[crc_next++];
+		fname = getfn(ix);
+		pthread_mutex_unlock(&crc_lock);
+
+		filelist[ix].crc32 = get_crc(fname, buf);
+		free(fname);
+	}
+	free(buf);
+	return NULL;
+}
+
 /* scan2 - full compare if CRC is equal */
 
 void
@@ -434,38 +531,39 @@ scan3()
 		free(headfn);
 }
 
-/* get_crc - get a CRC32 for a file */
+/* get_crc - get a CRC32 for a file, reading it through buf */
 
 uint32_t
-get_crc(ix)
-int ix;
+get_crc(fname, buf)
+char *fname;
+char *buf;
 {
-	FILE *fp;
-	char *fname = NULL;
-	ssize_t linelen = 0;
-	size_t len = 0;
+	int fd;
+	ssize_t got;
 	uint32_t crc = 0;
 
 	/* open the file */
-	fseek(namefd, filelist[ix].nameloc, 0);
-	linelen = getline(&fname, &len, namefd);
-	fname[linelen-1] = EOS;
 	debug(("\nCRC start - %s ", fname));
-	if ((fp = fopen(fname, "r")) == NULL) {
+	if ((fd = open(fname, O_RDONLY)) < 0) {
 		fprintf(stderr, "Can't read file %s\n", fname);
 		exit(1);
 	}
-	/* build the CRC values */
-	linelen = getline(&fname, &len, fp);
-	while(linelen >= 0) {
-		crc = rc_crc32(crc, fname, linelen);
-		linelen = getline(&fname, &len, fp);
+	/* it is read once, front to back, so let the kernel read ahead */
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	/* build the CRC values, a buffer at a time */
+	while ((got = read(fd, buf, CRC_BUFSIZE)) != 0) {
+		if (got < 0) {
+			if (errno == EINTR) continue;
+			fprintf(stderr, "Can't read file %s\n", fname);
+			exit(1);
+		}
+		crc = rc_crc32(crc, buf, got);
 	}
-	if (fname)
-        free(fname);
+	close(fd);
 	return crc;
 }
-
+
 /* getfn - get filename from index */
 
 char *